@@ -0,0 +1,177 @@
+import sys
+from log_events import load, Lifecycle
+
+# Attributes every abort in decoded task unit, CQ and (optionally) undo logs to
+# its cause, and ranks objects, task types and timestamp ranges by the work
+# their aborts wasted. See log_events.py for the inputs.
+#
+# Usage: python3 abort_report.py [--top=N] [--ts_buckets=N] log[@tile] ...
+#
+# Causes:
+#   conflict  a task with a lower ts was dequeued for the same object while
+#             this one was in the CQ (to_tq_abort with resource:0). The object
+#             is the conflict object, the dequeued task the aborter.
+#   resource  the CQ was full and this task had the highest ts in it, so it was
+#             aborted to make room for a lower ts task (resource:1).
+#   cascade   this task was a child of an aborted task (abort_child). Its root
+#             cause is that of the first non-cascade abort up the parent chain,
+#             or cascade if the parent is not in the logs.
+#   unknown   abort_task without a matching to_tq_abort, e.g. without a CQ log.
+#
+# Wasted cycles are the core cycles of the aborted execution, from start_task
+# to finish_task (or to the abort if it was still running). Restored writes are
+# the undo log restores of the aborted execution's CQ slot.
+
+CAUSES = ['conflict', 'resource', 'cascade', 'unknown']
+
+class Abort:
+    def __init__(self, task, e, cause, cycle):
+        self.task = task
+        self.exec = e
+        self.cause = cause
+        self.cycle = cycle
+        self.aborter = None     # Exec dequeued when a conflict was found
+        self.root = cause
+        self.depth = 0          # parents up the cascade
+        self.restored = 0
+
+    def cycles(self):
+        return self.exec.cycles() if self.exec is not None else 0
+
+class Attribution(Lifecycle):
+    def __init__(self):
+        Lifecycle.__init__(self)
+        self.aborts = []
+        self.cq_aborts = {}     # tile -> [(resource, aborter)] not yet matched
+        self.by_cq_slot = {}    # (tile, cq slot) -> last Abort of that slot
+        self.commit_cycles = 0
+        self.n_unattributed_restores = 0
+
+    def exec_end(self, e):
+        e.task.last_exec = e
+        if e.outcome == 'commit':
+            self.commit_cycles += e.cycles()
+
+    def add(self, a):
+        self.aborts.append(a)
+        if a.exec is not None:
+            a.exec.abort = a
+            self.by_cq_slot[(a.task.tile, a.exec.cq_slot)] = a
+
+    def task_abort(self, t, e, cycle):
+        pending = self.cq_aborts.get(t.tile, [])
+        if len(pending) > 0:
+            resource, aborter = pending.pop(0)
+            a = Abort(t, e, 'resource' if resource else 'conflict', cycle)
+            a.aborter = aborter
+        else:
+            a = Abort(t, e, 'unknown', cycle)
+        self.add(a)
+
+    def task_end(self, t, cycle, outcome):
+        if outcome != 'abort_child':
+            return
+        e = getattr(t, 'last_exec', None)
+        if e is not None and e.outcome != 'abort_child':
+            e = None    # an earlier execution, already accounted for
+        a = Abort(t, e, 'cascade', cycle)
+        p = getattr(t.parent, 'abort', None) if t.parent else None
+        if p is not None:
+            a.root = p.root
+            a.depth = p.depth + 1
+        else:
+            a.root = 'cascade'
+        self.add(a)
+
+    def other(self, tile, cycle, kind, args):
+        if kind == 'to_tq_abort':
+            self.cq_aborts.setdefault(tile, []).append(
+                    (args[0], self.last_deq.get(tile)))
+        elif kind == 'restore':
+            a = self.by_cq_slot.get((tile, args[0]))
+            if a is not None:
+                a.restored += args[1]
+            else:
+                self.n_unattributed_restores += args[1]
+
+def add_to(table, key, a):
+    row = table.setdefault(key, [0, 0, 0])
+    row[0] += 1
+    row[1] += a.cycles()
+    row[2] += a.restored
+
+def print_table(title, table, top, fmt_key):
+    print("%s" % title)
+    print("  %-24s %9s %12s %9s" % ('', 'aborts', 'cycles', 'restores'))
+    rows = sorted(table.items(), key=lambda kv: (-kv[1][1], -kv[1][0]))
+    for (key, row) in rows[:top]:
+        print("  %-24s %9d %12d %9d" % (fmt_key(key), row[0], row[1], row[2]))
+    if len(rows) > top:
+        print("  (%d more)" % (len(rows) - top))
+
+def main():
+    top = 10
+    n_buckets = 16
+    args = []
+    for arg in sys.argv[1:]:
+        if arg.startswith('--top='):
+            top = int(arg[6:])
+        elif arg.startswith('--ts_buckets='):
+            n_buckets = int(arg[13:])
+        else:
+            args.append(arg)
+    if len(args) == 0:
+        print("Usage: python3 abort_report.py [--top=N] [--ts_buckets=N] log[@tile] ...")
+        exit(0)
+
+    r = Attribution()
+    r.run(load(args))
+    aborts = r.aborts
+    wasted = sum(a.cycles() for a in aborts)
+    print("tasks %d, executions %d, aborts %d" %
+          (len(r.tasks), r.n_execs, len(aborts)))
+    if r.commit_cycles + wasted > 0:
+        print("core cycles: committed %d, aborted %d (%5.2f%% wasted)" %
+              (r.commit_cycles, wasted,
+               wasted * 100.0 / (r.commit_cycles + wasted)))
+    if r.n_unattributed_restores > 0:
+        print("restores without a known abort: %d" % r.n_unattributed_restores)
+    if len(aborts) == 0:
+        return
+
+    by_cause = {}
+    by_root = {}
+    by_object = {}
+    by_ttype = {}
+    by_aborter = {}
+    by_depth = {}
+    for a in aborts:
+        add_to(by_cause, a.cause, a)
+        add_to(by_root, a.root, a)
+        add_to(by_ttype, (a.task.ttype, a.cause), a)
+        add_to(by_depth, a.depth, a)
+        if a.cause == 'conflict':
+            add_to(by_object, a.task.obj, a)
+            if a.aborter is not None:
+                add_to(by_aborter, (a.aborter.task.ttype, a.task.ttype), a)
+
+    print_table("By cause", by_cause, len(CAUSES), str)
+    print_table("By root cause (cascades charged to the abort that started them)",
+                by_root, len(CAUSES), str)
+    print_table("Cascade depth", by_depth, top, lambda d: 'depth %d' % d)
+    print_table("Conflict objects", by_object, top, lambda o: '%x' % o)
+    print_table("Task types", by_ttype, top,
+                lambda k: 'ttype %d %s' % (k[0], k[1]))
+    print_table("Conflicts by aborter -> aborted task type", by_aborter, top,
+                lambda k: 'ttype %d -> ttype %d' % k)
+
+    lo = min(a.task.ts for a in aborts)
+    hi = max(a.task.ts for a in aborts)
+    width = max(1, (hi - lo + n_buckets) // n_buckets)
+    by_ts = {}
+    for a in aborts:
+        add_to(by_ts, (a.task.ts - lo) // width, a)
+    print_table("Timestamp ranges", by_ts, top,
+                lambda b: '[%x, %x)' % (lo + b * width, lo + (b + 1) * width))
+
+main()
@@ -0,0 +1,294 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host <-> FPGA link microbenchmarks (test_chronos [options] bench [file]).
+//
+// Measures, with the FPGA idle:
+//  - OCL latency: --bench_ocl_reps back-to-back peeks of OCL_CUR_CYCLE_LSB,
+//    pokes of OCL_TASK_ENQ_TTYPE (a plain latch), and poke + peek pairs,
+//    each timed individually. Repeated as ocl_mmio_* through the mapped BAR
+//    (pci_map_bar), if it maps, plus ocl_mmio_batch: runs of 64 pokes
+//    fenced by one peek (pci_batch_begin/end), timed per run.
+//  - DMA: for each transfer size in --bench_sizes and each channel count up
+//    to --dma_channels, one thread per channel moves the same size
+//    repeatedly to its own DDR region, until --bench_mb MB have moved (at
+//    least 8 and at most 4096 transfers per channel). Transfers are timed
+//    individually; GB/s is over the wall time of the whole point.
+//  - the 512 B chunking older shells needed: the largest size again, on one
+//    and on all channels, with every driver call capped at 512 B.
+// DDR contents are overwritten from address 0 up.
+//
+// Results go to stdout and, as a tab-separated table preceded by '#' lines
+// describing the host and the AFI, to the given file (bench.tsv by default),
+// so that runs on different instances and shell versions can be diffed.
+//   test dir channels bytes max_xfer n p50_us p99_us max_us GBps
+
+#include "header.h"
+
+#include <pthread.h>
+#include <sys/utsname.h>
+#include <time.h>
+
+#define BENCH_MAX_SIZES 16
+
+static const char* bench_default_sizes = "4096,65536,1048576,16777216";
+
+typedef struct {
+    int channel;
+    bool is_read;
+    unsigned char* buf;
+    size_t len;
+    size_t addr;
+    uint32_t n;
+    uint64_t* ns;         // [n] per transfer
+    int failed;
+} bench_worker_t;
+
+static uint64_t bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int bench_cmp(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+// Sorts ns and writes one row
+static void bench_row(FILE* fw, const char* test, const char* dir,
+        int channels, size_t bytes, size_t max_xfer, uint64_t* ns, uint32_t n,
+        double gbps) {
+    qsort(ns, n, sizeof(uint64_t), bench_cmp);
+    char ch[16] = "-", mx[24] = "-", bw[24] = "-";
+    if (channels > 0) sprintf(ch, "%d", channels);
+    if (max_xfer > 0) sprintf(mx, "%lu", max_xfer);
+    if (gbps >= 0) sprintf(bw, "%.3f", gbps);
+    char line[256];
+    sprintf(line, "%s\t%s\t%s\t%lu\t%s\t%u\t%.2f\t%.2f\t%.2f\t%s\n",
+            test, dir, ch, bytes, mx, n, ns[n / 2] / 1e3,
+            ns[(uint64_t) n * 99 / 100] / 1e3, ns[n - 1] / 1e3, bw);
+    fputs(line, fw);
+    fputs(line, stdout);
+}
+
+static void bench_ocl(FILE* fw, uint32_t reps, const char* prefix) {
+    uint64_t* ns = (uint64_t*) malloc(reps * sizeof(uint64_t));
+    uint32_t data;
+    uint32_t c0, c1;
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &c0);
+    for (uint32_t i=0;i<reps;i++) {
+        uint64_t t0 = bench_now_ns();
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &data);
+        ns[i] = bench_now_ns() - t0;
+    }
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &c1);
+    printf("# %s peek: %.1f FPGA cycles apart\n", prefix, (c1 - c0) / (reps + 1.0));
+    char test[32];
+    sprintf(test, "%s_peek", prefix);
+    bench_row(fw, test, "rd", 0, 4, 0, ns, reps, -1);
+
+    for (uint32_t i=0;i<reps;i++) {
+        uint64_t t0 = bench_now_ns();
+        pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, i);
+        ns[i] = bench_now_ns() - t0;
+    }
+    sprintf(test, "%s_poke", prefix);
+    bench_row(fw, test, "wr", 0, 4, 0, ns, reps, -1);
+
+    for (uint32_t i=0;i<reps;i++) {
+        uint64_t t0 = bench_now_ns();
+        pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, i);
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &data);
+        ns[i] = bench_now_ns() - t0;
+    }
+    sprintf(test, "%s_poke_peek", prefix);
+    bench_row(fw, test, "wr+rd", 0, 4, 0, ns, reps, -1);
+    free(ns);
+}
+
+static void bench_ocl_batch(FILE* fw, uint32_t reps, uint32_t batch) {
+    uint32_t runs = (reps + batch - 1) / batch;
+    uint64_t* ns = (uint64_t*) malloc(runs * sizeof(uint64_t));
+    for (uint32_t r=0;r<runs;r++) {
+        uint64_t t0 = bench_now_ns();
+        pci_batch_begin();
+        for (uint32_t i=0;i<batch;i++) {
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, i);
+        }
+        pci_batch_end();
+        ns[r] = bench_now_ns() - t0;
+    }
+    bench_row(fw, "ocl_mmio_batch", "wr", 0, batch * 4, 0, ns, runs, -1);
+    free(ns);
+}
+
+static void* bench_dma_worker(void* arg) {
+    bench_worker_t* w = (bench_worker_t*) arg;
+    for (uint32_t i=0;i<w->n;i++) {
+        uint64_t t0 = bench_now_ns();
+        if (dma_xfer(w->channel, w->is_read, w->buf, w->len, w->addr)) {
+            w->failed = 1;
+            return NULL;
+        }
+        w->ns[i] = bench_now_ns() - t0;
+    }
+    return NULL;
+}
+
+static int bench_dma(FILE* fw, const char* test, bool is_read, int channels,
+        size_t len, size_t max_xfer, size_t total, unsigned char** bufs) {
+    uint64_t n = total / (len * channels);
+    if (n < 8) n = 8;
+    if (n > 4096) n = 4096;
+    bench_worker_t w[DMA_MAX_CHANNELS];
+    pthread_t threads[DMA_MAX_CHANNELS];
+    uint64_t* ns = (uint64_t*) malloc(n * channels * sizeof(uint64_t));
+    // Regions start on 64 MB boundaries so that channels never share a page
+    size_t stride = (len + (64 << 20) - 1) & ~(size_t) ((64 << 20) - 1);
+
+    dma_set_max_xfer(max_xfer);
+    uint64_t t0 = bench_now_ns();
+    for (int c=0;c<channels;c++) {
+        w[c] = (bench_worker_t) { c, is_read, bufs[c], len, c * stride, n,
+            ns + c * n, 0 };
+        pthread_create(&threads[c], NULL, bench_dma_worker, &w[c]);
+    }
+    int failed = 0;
+    for (int c=0;c<channels;c++) {
+        pthread_join(threads[c], NULL);
+        failed |= w[c].failed;
+    }
+    uint64_t elapsed = bench_now_ns() - t0;
+    dma_set_max_xfer(0);
+
+    if (failed) {
+        printf("bench: %s %s failed at %lu bytes on %d channels\n", test,
+                is_read ? "c2h" : "h2c", len, channels);
+    } else {
+        bench_row(fw, test, is_read ? "c2h" : "h2c", channels, len, max_xfer,
+                ns, n * channels, (double) len * n * channels / elapsed);
+    }
+    free(ns);
+    return failed;
+}
+
+static void bench_header(FILE* fw, int slot_id) {
+    char host[256] = "?";
+    gethostname(host, sizeof(host) - 1);
+    struct utsname u;
+    uname(&u);
+    char instance[128] = "?";
+    FILE* f = fopen("/sys/devices/virtual/dmi/id/product_name", "r");
+    if (f != NULL) {
+        if (fgets(instance, sizeof(instance), f)) instance[strcspn(instance, "\n")] = 0;
+        fclose(f);
+    }
+    struct fpga_mgmt_image_info info = {0};
+    fpga_mgmt_describe_local_image(slot_id, &info, 0);
+    time_t now = time(NULL);
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(fw, "# date\t%s\n# host\t%s\n# instance\t%s\n# kernel\t%s %s\n",
+            date, host, instance, u.sysname, u.release);
+    fprintf(fw, "# afi\t%s\n# shell\t0x%08x\n# dma_channels\th2c %d c2h %d\n",
+            info.ids.afi_id, info.sh_version, dma_n_channels(false),
+            dma_n_channels(true));
+    fprintf(fw, "test\tdir\tchannels\tbytes\tmax_xfer\tn\tp50_us\tp99_us\tmax_us\tGBps\n");
+    printf("afi %s shell 0x%08x on %s (%s)\n", info.ids.afi_id, info.sh_version,
+            instance, host);
+    printf("test\tdir\tchannels\tbytes\tmax_xfer\tn\tp50_us\tp99_us\tmax_us\tGBps\n");
+}
+
+int bench_run(int slot_id, int pf_id, int bar_id, const char* path,
+        const char* sizes, uint32_t total_mb, uint32_t ocl_reps, int n_channels) {
+    size_t len[BENCH_MAX_SIZES];
+    int n_sizes = 0;
+    if (sizes == NULL || *sizes == 0) sizes = bench_default_sizes;
+    char* list = strdup(sizes);
+    for (char* tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (n_sizes == BENCH_MAX_SIZES) break;
+        len[n_sizes] = strtoul(tok, NULL, 0);
+        if (len[n_sizes] > 0) n_sizes++;
+    }
+    free(list);
+    if (n_sizes == 0) {
+        printf("bench: no transfer sizes in %s\n", sizes);
+        return 1;
+    }
+    size_t max_len = 0;
+    for (int i=0;i<n_sizes;i++) if (len[i] > max_len) max_len = len[i];
+    if (ocl_reps < 2) ocl_reps = 2;
+
+    if (dma_init(slot_id, n_channels)) return 1;
+    if (fpga_pci_attach(slot_id, pf_id, bar_id, 0, &pci_bar_handle)) {
+        printf("bench: unable to attach to the AFI on slot id %d\n", slot_id);
+        return 1;
+    }
+    FILE* fw = fopen(path, "w");
+    if (fw == NULL) {
+        printf("bench: unable to open %s\n", path);
+        return 1;
+    }
+    bench_header(fw, slot_id);
+    bench_ocl(fw, ocl_reps, "ocl");
+    if (pci_map_bar() == 0) {
+        bench_ocl(fw, ocl_reps, "ocl_mmio");
+        bench_ocl_batch(fw, ocl_reps, 64);
+        pci_unmap_bar();
+    }
+
+    unsigned char* bufs[DMA_MAX_CHANNELS];
+    int channels = dma_n_channels(false);
+    if (dma_n_channels(true) < channels) channels = dma_n_channels(true);
+    for (int c=0;c<channels;c++) {
+        if (posix_memalign((void**) &bufs[c], 4096, max_len)) {
+            printf("bench: unable to allocate %lu bytes\n", max_len);
+            return 1;
+        }
+        for (size_t i=0;i<max_len;i++) bufs[c][i] = i * 131 + c;
+    }
+    size_t total = (size_t) total_mb << 20;
+    int failed = 0;
+    for (int dir=0;dir<2;dir++) {
+        for (int s=0;s<n_sizes;s++) {
+            for (int c=1;c<=channels;c*=2) {
+                failed |= bench_dma(fw, "dma", dir, c, len[s], 0, total, bufs);
+            }
+            if (channels & (channels - 1)) {
+                failed |= bench_dma(fw, "dma", dir, channels, len[s], 0, total, bufs);
+            }
+        }
+        failed |= bench_dma(fw, "dma_512b", dir, 1, max_len, 512, total, bufs);
+        if (channels > 1) {
+            failed |= bench_dma(fw, "dma_512b", dir, channels, max_len, 512, total,
+                    bufs);
+        }
+    }
+    for (int c=0;c<channels;c++) free(bufs[c]);
+    fclose(fw);
+    dma_close();
+    printf("bench: results in %s\n", path);
+    return failed;
+}
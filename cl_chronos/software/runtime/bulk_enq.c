@@ -0,0 +1,227 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Bulk injection of initial tasks through the task-spilling area.
+//
+// Instead of enqueueing each task over OCL, the tasks are written into the
+// per-tile spill area in the layout the coalescer produces (see coalescer.sv,
+// splitter.sv and spill_config.vh): 8 tasks per splitter, 16 splitters per
+// chunk, chunks allocated from the free-chunk stack, whose pointer is
+// advanced past the chunks used. The splitter tasks that point at these
+// splitters are themselves packed into further splitters, as the coalescer
+// does when the task queue spills splitter tasks, until at most
+// BULK_ROOT_SPLITTERS remain per tile; only those are enqueued over OCL. The
+// splitter core then expands the tree from DDR. Tasks are placed on the tile
+// the TSB would route them to, so the splitter's enqueues stay tile-local.
+
+#include "header.h"
+
+#define TASKS_PER_SPLITTER 8
+#define SPLITTERS_PER_CHUNK (1 << LOG_SPLITTERS_PER_CHUNK)
+#define BULK_ROOT_SPLITTERS 16
+// coal_id is 16 bits wide in the coalescer
+#define MAX_SPLITTER_CHUNKS ((1 << 16) / SPLITTERS_PER_CHUNK)
+
+static uint32_t clog2(uint32_t x) {
+    uint32_t r = 0;
+    while ((1u << r) < x) r++;
+    return r;
+}
+
+// Sets bits [lsb, lsb+width) of a little-endian bit vector.
+static void put_bits(unsigned char* dst, uint32_t lsb, uint32_t width, uint32_t val) {
+    for (uint32_t i=0;i<width;i++) {
+        if ((val >> i) & 1) dst[(lsb + i) >> 3] |= 1 << ((lsb + i) & 7);
+    }
+}
+
+// task_t (types.vh), from the LSB: ttype, ts, object, non_spec, no_read,
+// no_write, producer, args. Bit TQ_WIDTH marks an empty slot.
+static void pack_task(unsigned char* dst, const init_task_t* t, const task_fmt_t* fmt,
+        bool splitter) {
+    uint32_t bit = 0;
+    put_bits(dst, bit, fmt->ttype_bits, t->ttype); bit += fmt->ttype_bits;
+    put_bits(dst, bit, 32, t->ts);                 bit += 32;
+    put_bits(dst, bit, 32, t->object);             bit += 32;
+    // Splitter tasks are marked producer and no_write, as in coalescer.sv
+    if (splitter) put_bits(dst, bit + 2, 2, 3);
+    bit += 4;
+    if (splitter) return;
+    for (uint32_t w=0; w*32 < fmt->arg_bits; w++) {
+        uint32_t width = fmt->arg_bits - w*32;
+        put_bits(dst, bit + w*32, width > 32 ? 32 : width, t->args[w]);
+    }
+}
+
+static uint32_t tq_width(const task_fmt_t* fmt) {
+    return fmt->ttype_bits + 32 + 32 + 4 + fmt->arg_bits;
+}
+
+// Number of splitters needed for a tile with n tasks, over all levels of the
+// tree, and the number of root splitters left to enqueue over OCL.
+static size_t tree_splitters(size_t n, size_t* n_root) {
+    size_t total = 0;
+    size_t level = (n + TASKS_PER_SPLITTER - 1) / TASKS_PER_SPLITTER;
+    total += level;
+    while (level > BULK_ROOT_SPLITTERS) {
+        level = (level + TASKS_PER_SPLITTER - 1) / TASKS_PER_SPLITTER;
+        total += level;
+    }
+    *n_root = level;
+    return total;
+}
+
+int bulk_enqueue(const init_task_t* tasks, size_t n_tasks, const task_fmt_t* fmt,
+        uint32_t n_tiles, bool use_hash) {
+    uint32_t width = tq_width(fmt);
+    uint32_t task_bytes = (1u << clog2(width)) / 8;
+    if (width >= task_bytes * 8 || fmt->arg_bits > 32 * 4) {
+        printf("bulk_enqueue: unsupported task format (%d bits)\n", width);
+        return 1;
+    }
+    uint32_t splitter_bytes = task_bytes * TASKS_PER_SPLITTER;
+    uint32_t chunk_bytes = splitter_bytes * SPLITTERS_PER_CHUNK;
+    uint32_t max_chunks = 1 << HW_LOG_SPLITTER_STACK_SIZE;
+    if (max_chunks > MAX_SPLITTER_CHUNKS) max_chunks = MAX_SPLITTER_CHUNKS;
+    if (max_chunks > SPILL_TASK_BASE_OFFSET / chunk_bytes) {
+        max_chunks = SPILL_TASK_BASE_OFFSET / chunk_bytes;
+    }
+    // Keep a quarter of the chunks free for the coalescer
+    max_chunks -= max_chunks / 4;
+
+    size_t* tile_count = (size_t*) calloc(n_tiles, sizeof(size_t));
+    uint32_t* task_tile = (uint32_t*) malloc(n_tasks * sizeof(uint32_t));
+    for (size_t i=0;i<n_tasks;i++) {
+        task_tile[i] = tsb_tile(tasks[i].object, n_tiles, use_hash);
+        tile_count[task_tile[i]]++;
+    }
+    for (uint32_t t=0;t<n_tiles;t++) {
+        size_t n_root;
+        size_t n_chunks = (tree_splitters(tile_count[t], &n_root) + SPLITTERS_PER_CHUNK - 1)
+            / SPLITTERS_PER_CHUNK;
+        if (n_chunks > max_chunks) {
+            printf("bulk_enqueue: tile %d needs %lu spill chunks, only %d available"
+                    " (hw splitter stack 2^%d)\n",
+                    t, n_chunks, max_chunks, HW_LOG_SPLITTER_STACK_SIZE);
+            free(tile_count);
+            free(task_tile);
+            return 1;
+        }
+    }
+
+    uint32_t ttype_splitter = (1 << fmt->ttype_bits) - 2;
+    unsigned char line[64];
+    for (uint32_t t=0;t<n_tiles;t++) {
+        size_t count = tile_count[t];
+        if (count == 0) continue;
+        size_t n_root;
+        size_t n_splitters = tree_splitters(count, &n_root);
+        size_t n_chunks = (n_splitters + SPLITTERS_PER_CHUNK - 1) / SPLITTERS_PER_CHUNK;
+        size_t spill_base = ADDR_BASE_SPILL + (size_t) t * TOTAL_SPILL_ALLOCATION;
+
+        // The free-chunk stack holds chunk i at entry i (Stage 2), so chunks
+        // 0..n_chunks-1 are the ones popped by advancing the pointer.
+        // Splitters [0, n_leaf) hold the tasks; each following level holds
+        // the splitter tasks of the previous one.
+        unsigned char* image = (unsigned char*) calloc(n_chunks, chunk_bytes);
+        uint32_t* min_ts = (uint32_t*) malloc(n_splitters * sizeof(uint32_t));
+        memset(min_ts, 0xff, n_splitters * sizeof(uint32_t));
+        size_t slot = 0;
+        for (size_t i=0;i<n_tasks;i++) {
+            if (task_tile[i] != t) continue;
+            pack_task(image + slot * task_bytes, &tasks[i], fmt, false);
+            if (tasks[i].ts < min_ts[slot / TASKS_PER_SPLITTER]) {
+                min_ts[slot / TASKS_PER_SPLITTER] = tasks[i].ts;
+            }
+            slot++;
+        }
+        size_t level_begin = 0;
+        size_t level_end = (count + TASKS_PER_SPLITTER - 1) / TASKS_PER_SPLITTER;
+        while (level_end - level_begin > BULK_ROOT_SPLITTERS) {
+            // pad the previous level's last splitter
+            for (; slot < level_end * TASKS_PER_SPLITTER; slot++) {
+                put_bits(image + slot * task_bytes, width, 1, 1);
+            }
+            for (size_t s=level_begin;s<level_end;s++) {
+                init_task_t st = { ttype_splitter, min_ts[s], (s << 16) | (t << 4), {0} };
+                pack_task(image + slot * task_bytes, &st, fmt, true);
+                if (st.ts < min_ts[slot / TASKS_PER_SPLITTER]) {
+                    min_ts[slot / TASKS_PER_SPLITTER] = st.ts;
+                }
+                slot++;
+            }
+            level_begin = level_end;
+            level_end = (slot + TASKS_PER_SPLITTER - 1) / TASKS_PER_SPLITTER;
+        }
+        for (; slot < n_splitters * TASKS_PER_SPLITTER; slot++) {
+            put_bits(image + slot * task_bytes, width, 1, 1);
+        }
+        if (dma_write(image, n_chunks * chunk_bytes, spill_base + SPILL_TASK_BASE_OFFSET)) {
+            free(image);
+            free(min_ts);
+            free(tile_count);
+            free(task_tile);
+            return 1;
+        }
+        free(image);
+
+        memset(line, 0, sizeof(line));
+        line[STACK_PTR_ADDR_OFFSET    ] = n_chunks & 0xff;
+        line[STACK_PTR_ADDR_OFFSET + 1] = n_chunks >> 8;
+        if (dma_write(line, 64, spill_base)) {
+            free(min_ts);
+            free(tile_count);
+            free(task_tile);
+            return 1;
+        }
+
+        // Mark the unused splitters of the last chunk as done, so that the
+        // chunk is returned to the stack once its used splitters complete.
+        uint32_t used = n_splitters - (n_chunks - 1) * SPLITTERS_PER_CHUNK;
+        if (used < SPLITTERS_PER_CHUNK) {
+            uint32_t entry = ((1 << SPLITTERS_PER_CHUNK) - 1) & ~((1 << used) - 1);
+            size_t entry_addr = SCRATCHPAD_BASE_OFFSET + (n_chunks - 1) * 2;
+            memset(line, 0, sizeof(line));
+            line[(entry_addr & 63)    ] = entry & 0xff;
+            line[(entry_addr & 63) + 1] = entry >> 8;
+            if (dma_write(line, 64, spill_base + (entry_addr & ~63ul))) {
+                free(min_ts);
+                free(tile_count);
+                free(task_tile);
+                return 1;
+            }
+        }
+
+        pci_poke(t, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, ttype_splitter);
+        for (size_t s=level_begin;s<level_end;s++) {
+            pci_poke(t, ID_OCL_SLAVE, OCL_TASK_ENQ_OBJECT, (s << 16) | (t << 4));
+            pci_poke(t, ID_OCL_SLAVE, OCL_TASK_ENQ, min_ts[s]);
+        }
+        printf("bulk_enqueue: tile %d %lu tasks in %lu splitters, %lu enqueued\n",
+                t, count, n_splitters, n_root);
+        free(min_ts);
+    }
+    free(tile_count);
+    free(task_tile);
+    return 0;
+}
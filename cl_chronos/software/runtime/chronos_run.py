@@ -0,0 +1,30 @@
+import re
+import subprocess
+
+# One test_chronos run, shared by tune.py and prefetch_sweep.py.
+#
+# test_chronos exits non-zero when the run fails, times out, cannot read its
+# results back or does not verify, so the exit status alone decides whether
+# a run counts. The output is only parsed for the figures the scripts report.
+
+class Run:
+    def __init__(self, returncode, out):
+        self.returncode = returncode
+        self.out = out
+        m = re.search(r'^FPGA cycles (\d+)', out, re.M)
+        self.cycles = int(m.group(1)) if m else None
+        # cycles is None unless the run completed and verified
+        if returncode != 0:
+            self.cycles = None
+
+    def ok(self):
+        return self.cycles is not None
+
+    def field(self, pat):
+        m = re.search(pat, self.out, re.M)
+        return m.group(1) if m else None
+
+def run(cmd):
+    p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       universal_newlines=True)
+    return Run(p.returncode, p.stdout)
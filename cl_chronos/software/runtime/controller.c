@@ -0,0 +1,264 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host-side throttle controller (--ctrl=1).
+//
+// TASK_UNIT_THROTTLE_MARGIN (dequeue only tasks with ts < gvt + margin) and
+// SERIALIZER_N_MAX_RUNNING_TASKS are otherwise set once before the run. With
+// the controller on, a thread samples every tile each --ctrl_ms milliseconds
+// and retunes both per tile:
+//  - if aborts exceed --ctrl_target percent of the finished tasks (commits +
+//    aborts) in the interval, it tightens: the margin shrinks by 1/4, and once
+//    the margin is at its floor, max running tasks drops by one.
+//  - otherwise it hill-climbs on the commit rate (commits per kcycle): it
+//    loosens until the rate falls by more than CTRL_RATE_SLACK, then tightens
+//    for as long as that raises the rate by more than CTRL_RATE_SLACK. It
+//    does not loosen while the waste is within 1/4 of the target.
+//  - it holds when the tile finished too few tasks or its queue is empty,
+//    since neither knob changes anything then.
+// The margin stays within [margin/16, margin*16] of its starting value, and
+// max running tasks within [1, cap]. Under NO_ROLLBACK nothing aborts and the
+// task unit does not count commits, so dequeues stand in for commits.
+//
+// Every decision is written to --ctrl_log as a CSV row:
+//   cycle,tile,commits,aborts,waste_pct,n_tasks,rate,margin,max_running,action
+
+#include "header.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#define CTRL_MAX_TILES 16
+#define CTRL_MIN_EVENTS 64      // finished tasks per interval to act on
+#define CTRL_RATE_SLACK 0.03
+
+enum { CTRL_HOLD, CTRL_TIGHTEN, CTRL_LOOSEN, CTRL_N_ACTIONS };
+static const char* ctrl_action_names[CTRL_N_ACTIONS] =
+    { "hold", "tighten", "loosen" };
+
+typedef struct {
+    uint32_t commits, aborts;   // counter values at the last sample
+    uint32_t margin, max_running;
+    int dir;                    // +1 loosen, -1 tighten
+    double rate;                // commit rate of the last interval
+    uint64_t n_actions[CTRL_N_ACTIONS];
+    uint64_t tot_commits, tot_aborts;
+} ctrl_tile_t;
+
+static struct {
+    FILE* fw;
+    uint32_t n_tiles;
+    bool no_rollback;
+    uint32_t interval_ms;
+    double target;              // max aborts / (commits + aborts)
+    uint32_t margin_min, margin_max;
+    uint32_t running_cap;
+    ctrl_tile_t tiles[CTRL_MAX_TILES];
+    volatile bool stop;
+    pthread_t thread;
+    bool running;
+    uint64_t n_samples;
+} ctrl;
+
+static void ctrl_read(uint32_t tile, uint32_t* commits, uint32_t* aborts) {
+    uint32_t a, b;
+    if (ctrl.no_rollback) {
+        pci_peek(tile, ID_TASK_UNIT, TASK_UNIT_STAT_N_DEQ_TASK, commits);
+        *aborts = 0;
+        return;
+    }
+    pci_peek(tile, ID_TASK_UNIT, TASK_UNIT_STAT_N_COMMIT_TIED, &a);
+    pci_peek(tile, ID_TASK_UNIT, TASK_UNIT_STAT_N_COMMIT_UNTIED, &b);
+    *commits = a + b;
+    pci_peek(tile, ID_TASK_UNIT, TASK_UNIT_STAT_N_ABORT_TASK, &a);
+    pci_peek(tile, ID_TASK_UNIT, TASK_UNIT_STAT_N_ABORT_CHILD_DEQ, &b);
+    *aborts = a + b;
+}
+
+static int ctrl_step(ctrl_tile_t* t, int dir) {
+    uint32_t margin = t->margin;
+    uint32_t max_running = t->max_running;
+    if (dir > 0) {
+        margin += (margin / 4 > 0) ? margin / 4 : 1;
+        if (margin > ctrl.margin_max) margin = ctrl.margin_max;
+        if (max_running < ctrl.running_cap) max_running++;
+    } else {
+        margin -= margin / 4;
+        if (margin < ctrl.margin_min) margin = ctrl.margin_min;
+        if (margin == t->margin && max_running > 1) max_running--;
+    }
+    if (margin == t->margin && max_running == t->max_running) return CTRL_HOLD;
+    t->margin = margin;
+    t->max_running = max_running;
+    return (dir > 0) ? CTRL_LOOSEN : CTRL_TIGHTEN;
+}
+
+static int ctrl_decide(ctrl_tile_t* t, uint32_t commits, uint32_t aborts,
+        uint32_t n_tasks, double rate) {
+    uint32_t finished = commits + aborts;
+    if (finished < CTRL_MIN_EVENTS || n_tasks == 0) return CTRL_HOLD;
+    double waste = (double) aborts / finished;
+    if (waste > ctrl.target) {
+        t->dir = -1;
+        return ctrl_step(t, -1);
+    }
+    // Loosening is the default: keep tightening only while it pays off
+    if (t->dir > 0 && rate < t->rate * (1 - CTRL_RATE_SLACK)) {
+        t->dir = -1;
+    } else if (t->dir < 0 && rate <= t->rate * (1 + CTRL_RATE_SLACK)) {
+        t->dir = 1;
+    }
+    if (t->dir > 0 && waste > ctrl.target * 0.75) return CTRL_HOLD;
+    return ctrl_step(t, t->dir);
+}
+
+static void* ctrl_thread(void* arg) {
+    uint32_t lsb;
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+    uint32_t last_lsb = lsb;
+    uint32_t msb;
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb);
+    uint64_t cycle = ((uint64_t) msb << 32) | lsb;
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!ctrl.stop) {
+        next.tv_nsec += ctrl.interval_ms * 1000000l;
+        while (next.tv_nsec >= 1000000000l) {
+            next.tv_nsec -= 1000000000l;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        if (ctrl.stop) break;
+
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+        uint32_t cycles = lsb - last_lsb;
+        last_lsb = lsb;
+        cycle += cycles;
+        ctrl.n_samples++;
+        if (cycles == 0) continue;
+
+        for (uint32_t i=0;i<ctrl.n_tiles;i++) {
+            ctrl_tile_t* t = &ctrl.tiles[i];
+            uint32_t commits, aborts, n_tasks;
+            ctrl_read(i, &commits, &aborts);
+            pci_peek(i, ID_TASK_UNIT, TASK_UNIT_N_TASKS, &n_tasks);
+            // 32-bit counters; unsigned deltas survive a wrap
+            uint32_t d_commits = commits - t->commits;
+            uint32_t d_aborts = aborts - t->aborts;
+            t->commits = commits;
+            t->aborts = aborts;
+            t->tot_commits += d_commits;
+            t->tot_aborts += d_aborts;
+
+            double rate = d_commits * 1000.0 / cycles;
+            int action = ctrl_decide(t, d_commits, d_aborts, n_tasks, rate);
+            t->rate = rate;
+            t->n_actions[action]++;
+            if (action != CTRL_HOLD) {
+                pci_poke(i, ID_TASK_UNIT, TASK_UNIT_THROTTLE_MARGIN, t->margin);
+                pci_poke(i, ID_SERIALIZER, SERIALIZER_N_MAX_RUNNING_TASKS,
+                        t->max_running);
+            }
+            uint32_t finished = d_commits + d_aborts;
+            fprintf(ctrl.fw, "%lu,%u,%u,%u,%.2f,%u,%.2f,%u,%u,%s\n",
+                    cycle, i, d_commits, d_aborts,
+                    finished ? d_aborts * 100.0 / finished : 0.0,
+                    n_tasks, rate, t->margin, t->max_running,
+                    ctrl_action_names[action]);
+        }
+    }
+    return NULL;
+}
+
+// margin and max_running are the values the tiles were configured with;
+// running_cap bounds max_running from above (the number of threads that
+// can run tasks). target_pct is the wasted work the controller aims to stay
+// under.
+int controller_start(const char* path, uint32_t n_tiles, uint32_t interval_ms,
+        double target_pct, uint32_t margin, uint32_t max_running,
+        uint32_t running_cap) {
+    memset(&ctrl, 0, sizeof(ctrl));
+    if (n_tiles > CTRL_MAX_TILES) {
+        printf("ctrl: at most %d tiles\n", CTRL_MAX_TILES);
+        return 1;
+    }
+    if (margin == 0) {
+        printf("ctrl: needs a non-zero starting throttle margin\n");
+        return 1;
+    }
+    ctrl.fw = fopen(path, "w");
+    if (ctrl.fw == NULL) {
+        printf("ctrl: unable to open %s\n", path);
+        return 1;
+    }
+    ctrl.no_rollback = NO_ROLLBACK;
+    ctrl.n_tiles = n_tiles;
+    if (interval_ms < 1) interval_ms = 1;
+    if (interval_ms > 1000) interval_ms = 1000;
+    ctrl.interval_ms = interval_ms;
+    ctrl.target = target_pct / 100;
+    ctrl.margin_min = (margin / 16 > 0) ? margin / 16 : 1;
+    ctrl.margin_max = (margin > 0xffffffffu / 16) ? 0xffffffffu : margin * 16;
+    if (running_cap < 1) running_cap = 1;
+    ctrl.running_cap = running_cap;
+    if (max_running > running_cap) max_running = running_cap;
+
+    for (uint32_t i=0;i<n_tiles;i++) {
+        ctrl_tile_t* t = &ctrl.tiles[i];
+        t->margin = margin;
+        t->max_running = max_running;
+        t->dir = 1;
+        ctrl_read(i, &t->commits, &t->aborts);
+        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_THROTTLE_MARGIN, margin);
+        pci_poke(i, ID_SERIALIZER, SERIALIZER_N_MAX_RUNNING_TASKS, max_running);
+    }
+    fprintf(ctrl.fw, "cycle,tile,commits,aborts,waste_pct,n_tasks,rate,"
+            "margin,max_running,action\n");
+    if (pthread_create(&ctrl.thread, NULL, ctrl_thread, NULL)) {
+        printf("ctrl: unable to start controller\n");
+        fclose(ctrl.fw);
+        return 1;
+    }
+    ctrl.running = true;
+    return 0;
+}
+
+void controller_stop() {
+    if (!ctrl.running) return;
+    ctrl.stop = true;
+    pthread_join(ctrl.thread, NULL);
+    fclose(ctrl.fw);
+    ctrl.running = false;
+    printf("ctrl: %lu samples every %u ms, target %.1f%% wasted\n",
+            ctrl.n_samples, ctrl.interval_ms, ctrl.target * 100);
+    for (uint32_t i=0;i<ctrl.n_tiles;i++) {
+        ctrl_tile_t* t = &ctrl.tiles[i];
+        uint64_t finished = t->tot_commits + t->tot_aborts;
+        printf("ctrl: tile %2u margin %8u max_running %3u "
+                "tighten %5lu loosen %5lu hold %5lu wasted %5.2f%%\n",
+                i, t->margin, t->max_running, t->n_actions[CTRL_TIGHTEN],
+                t->n_actions[CTRL_LOOSEN], t->n_actions[CTRL_HOLD],
+                finished ? t->tot_aborts * 100.0 / finished : 0.0);
+    }
+}
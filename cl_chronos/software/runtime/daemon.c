@@ -0,0 +1,314 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Persistent runtime (test_chronos [options] daemon [socket]).
+//
+// The daemon owns the slot: the AFI check, the DMA queues, the BAR0
+// attachment and init_params() are done once. Jobs arrive over a UNIX stream
+// socket (DAEMON_SOCKET by default), one per connection, as a single line with
+// what test_chronos would take after its own options:
+//     [--option=val ...] app input [riscv_hex_file]
+// e.g.  echo "--n_tiles=4 sssp /data/usa.sssp" | nc -U /tmp/chronos.sock
+// Options given to the daemon itself are the defaults of every job. Each job
+// runs in a forked process with its stdout and stderr on the connection, so
+// that its options and its failures (the runtime exits on most errors) stay
+// out of the daemon; jobs run one at a time, in arrival order. The line
+// "shutdown" stops the daemon.
+//
+// What survives across jobs lives in memory shared with the job processes
+// (resident_t):
+//  - the input in DDR, by content hash. A job on the same input as the last
+//    one only re-uploads the header words and the arrays the app writes
+//    (resident_regions()). Hashes are cached per (device, inode, size, mtime),
+//    so an unchanged file is not read twice.
+//  - the last value written to each OCL register, so that pci_config() skips
+//    configuration writes that would change nothing.
+// Both are dropped if a job does not get to the end of test_chronos(), as DDR
+// and the registers are then in an unknown state.
+//
+// The header offsets of an input are absolute DDR addresses, so DDR holds one
+// input at a time; alternating between inputs uploads each of them in full.
+
+#include "header.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define DAEMON_MAX_LINE 4096
+#define DAEMON_MAX_ARGS 64
+#define RESIDENT_MAX_REGIONS 4
+#define RESIDENT_HEADER_BYTES 64
+
+resident_t* resident = NULL;
+static int listen_fd = -1;
+
+// Four independent multiply-xorshift lanes over 8-byte words. Not meant to
+// resist collisions made on purpose, only to tell inputs apart.
+static uint64_t hash_bytes(const unsigned char* p, size_t len) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h[4] = {len, len ^ m, len + m, ~len};
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        for (int k=0;k<4;k++) {
+            uint64_t w;
+            memcpy(&w, p + i + 8*k, 8);
+            h[k] = (h[k] ^ w) * m;
+            h[k] ^= h[k] >> 29;
+        }
+    }
+    for (; i < len; i++) h[0] = (h[0] ^ p[i]) * m;
+    uint64_t r = 0;
+    for (int k=0;k<4;k++) {
+        r = (r ^ h[k]) * m;
+        r ^= r >> 32;
+    }
+    return r;
+}
+
+uint64_t resident_hash(const char* path, const chronos_input_t* in) {
+    struct stat st;
+    bool have_id = (stat(path, &st) == 0);
+    resident_file_t id;
+    if (have_id) {
+        id.dev = st.st_dev;
+        id.ino = st.st_ino;
+        id.size = st.st_size;
+        id.mtime_ns = st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+        for (int i=0;i<RESIDENT_FILES;i++) {
+            resident_file_t* f = &resident->files[i];
+            if (f->dev == id.dev && f->ino == id.ino && f->size == id.size &&
+                    f->mtime_ns == id.mtime_ns) {
+                return f->hash;
+            }
+        }
+    }
+    uint64_t t0 = timer_ns();
+    id.hash = hash_bytes(in->data, in->len);
+    printf("Input hash %016lx (%.3f ms)\n", id.hash, (timer_ns() - t0) / 1e6);
+    if (have_id) {
+        resident->files[resident->next_file] = id;
+        resident->next_file = (resident->next_file + 1) % RESIDENT_FILES;
+    }
+    return id.hash;
+}
+
+// The parts of the input an app writes, which have to be restored before it
+// runs on a resident copy. Returns -1 for apps whose writes are not known
+// here; their inputs are always uploaded in full.
+static int resident_regions(int app, const uint32_t* headers, size_t* addr,
+        size_t* len) {
+    uint32_t numV = headers[1];
+    int n = 0;
+    switch (app) {
+        case APP_SSSP:
+        case APP_ASTAR:
+            addr[n] = headers[5] * 4ul; len[n++] = numV * 4ul;    // dist
+            return n;
+        case APP_COLOR:
+            addr[n] = headers[5] * 4ul; len[n++] = numV * 16ul;   // color_node_prop_t
+            addr[n] = headers[7] * 4ul; len[n++] = numV * 8ul;    // scratch
+            return n;
+        case APP_MAXFLOW:
+            addr[n] = headers[5] * 4ul; len[n++] = numV * 64ul;   // maxflow_node_prop_t
+            return n;
+    }
+    return -1;
+}
+
+int resident_upload(int app, const chronos_input_t* in, uint64_t hash) {
+    size_t addr[RESIDENT_MAX_REGIONS], len[RESIDENT_MAX_REGIONS];
+    int n = resident_regions(app, in->headers, addr, len);
+    if (n >= 0 && resident->valid && resident->hash == hash &&
+            resident->len == in->len && resident->app == app) {
+        // The headers were patched for this job
+        int rc = dma_write(in->data, RESIDENT_HEADER_BYTES, 0);
+        size_t bytes = RESIDENT_HEADER_BYTES;
+        for (int i=0;i<n;i++) {
+            if (addr[i] >= in->len) continue;
+            if (addr[i] + len[i] > in->len) len[i] = in->len - addr[i];
+            rc |= dma_write(in->data + addr[i], len[i], addr[i]);
+            bytes += len[i];
+        }
+        printf("Input resident in DDR, reset %lu of %lu bytes\n", bytes, in->len);
+        return rc;
+    }
+    resident->valid = false;
+    int rc = dma_write(in->data, in->len, 0);
+    if (rc == 0 && n >= 0) {
+        resident->hash = hash;
+        resident->len = in->len;
+        resident->app = app;
+        resident->valid = true;
+    }
+    return rc;
+}
+
+static inline uint32_t shadow_slot(uint32_t ocl_addr) {
+    return (((ocl_addr >> 2) * 2654435761u) >> 16) % RESIDENT_SHADOW_SIZE;
+}
+
+// Entries are written whole, as the controller and telemetry threads of a job
+// can poke concurrently with the main one. A slot holds one register; a
+// collision only costs a write that could have been skipped.
+void resident_shadow_store(uint32_t ocl_addr, uint32_t data) {
+    uint64_t e = (1ull << 63) | ((uint64_t) ocl_addr << 32) | data;
+    __atomic_store_n(&resident->shadow[shadow_slot(ocl_addr)], e, __ATOMIC_RELAXED);
+}
+
+bool resident_shadow_match(uint32_t ocl_addr, uint32_t data) {
+    uint64_t e = (1ull << 63) | ((uint64_t) ocl_addr << 32) | data;
+    return __atomic_load_n(&resident->shadow[shadow_slot(ocl_addr)],
+            __ATOMIC_RELAXED) == e;
+}
+
+static void resident_drop() {
+    resident->valid = false;
+    memset(resident->shadow, 0, sizeof(resident->shadow));
+}
+
+// Reads one line (without the newline) from a connection
+static int daemon_read_line(int fd, char* line, size_t size) {
+    size_t n = 0;
+    while (n + 1 < size) {
+        ssize_t r = read(fd, line + n, 1);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0 || line[n] == '\n') break;
+        n++;
+    }
+    line[n] = 0;
+    if (n > 0 && line[n-1] == '\r') line[--n] = 0;
+    return n;
+}
+
+// Runs a job in a child process; returns its exit status, or -1 if it was
+// killed.
+static int daemon_job(int slot_id, int conn, char* line) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        dprintf(conn, "daemon: fork failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (pid == 0) {
+        close(listen_fd);
+        dup2(conn, STDOUT_FILENO);
+        dup2(conn, STDERR_FILENO);
+        close(conn);
+        char* argv[DAEMON_MAX_ARGS + 1];
+        int argc = 0;
+        for (char* tok = strtok(line, " \t"); tok != NULL && argc < DAEMON_MAX_ARGS;
+                tok = strtok(NULL, " \t")) {
+            argv[argc++] = tok;
+        }
+        argv[argc] = NULL;
+        int cur_arg = parse_options(argc, argv, 0);
+        if (cur_arg >= argc) {
+            printf("Usage: [--options=val] app <input> <riscv_hex_file>\n");
+            exit(1);
+        }
+        resident->busy = true;
+        int rc = run_app(slot_id, argc, argv, cur_arg);
+        // only a job that died mid-run leaves busy set; a failed run still
+        // left the slot in a consistent state
+        resident->busy = false;
+        exit(rc);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) ;
+    if (resident->busy) {
+        printf("daemon: job did not complete, dropping resident input and "
+                "register state\n");
+        resident_drop();
+        resident->busy = false;
+        // whatever status the child exited with, the job did not finish
+        return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int daemon_run(int slot_id, const char* path) {
+    resident = (resident_t*) mmap(NULL, sizeof(resident_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (resident == MAP_FAILED) {
+        resident = NULL;
+        printf("daemon: unable to allocate shared state\n");
+        return 1;
+    }
+    memset(resident, 0, sizeof(resident_t));
+
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        printf("daemon: socket path %s too long\n", path);
+        return 1;
+    }
+    strcpy(sa.sun_path, path);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &sa, sizeof(sa)) != 0 ||
+            listen(listen_fd, 16) != 0) {
+        printf("daemon: unable to listen on %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    // a client that goes away must not take the job (or the daemon) with it
+    signal(SIGPIPE, SIG_IGN);
+    printf("daemon: slot %d, %d tiles, listening on %s\n", slot_id, N_TILES, path);
+
+    uint64_t n_jobs = 0;
+    while (true) {
+        int conn = accept(listen_fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            printf("daemon: accept failed: %s\n", strerror(errno));
+            break;
+        }
+        char line[DAEMON_MAX_LINE];
+        if (daemon_read_line(conn, line, sizeof(line)) == 0) {
+            close(conn);
+            continue;
+        }
+        if (strcmp(line, "shutdown") == 0) {
+            dprintf(conn, "daemon: shutting down after %lu jobs\n", n_jobs);
+            close(conn);
+            break;
+        }
+        n_jobs++;
+        printf("daemon: job %lu: %s\n", n_jobs, line);
+        uint64_t t0 = timer_ns();
+        int status = daemon_job(slot_id, conn, line);
+        double ms = (timer_ns() - t0) / 1e6;
+        dprintf(conn, "daemon: job %lu exit %d, %.3f ms\n", n_jobs, status, ms);
+        printf("daemon: job %lu exit %d, %.3f ms\n", n_jobs, status, ms);
+        close(conn);
+    }
+    close(listen_fd);
+    unlink(path);
+    dma_close();
+    return 0;
+}
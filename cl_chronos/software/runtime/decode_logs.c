@@ -0,0 +1,218 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Offline decoder for raw debug log dumps (test_chronos --log_raw=<file>).
+//
+//   decode_logs [--threads=N] [--format=text|csv] [--out=<dir>] <dump>
+//
+// The dump is mmap'd and split into one stream per (component kind, ID).
+// Streams are decoded in parallel, except that the streams of one kind share
+// a worker, as some decoders keep state across records (see log_decode.c).
+// --format=text (default) produces the same text as the runtime's loggers;
+// --format=csv writes one row per record with the 16 raw words as columns.
+// Each stream goes to <dir>/<kind>_<ID in hex>.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log_decode.h"
+
+#define MAX_STREAMS 256
+
+typedef struct {
+    log_kind_t kind;
+    uint32_t id;
+    uint32_t n_blocks;
+    uint32_t cap_blocks;
+    const log_block_hdr_t** blocks;
+    uint64_t n_records;
+} stream_t;
+
+static stream_t streams[MAX_STREAMS];
+static uint32_t n_streams = 0;
+static const char* out_dir = ".";
+static bool csv = false;
+static int next_kind = 0;
+
+static stream_t* get_stream(log_kind_t kind, uint32_t id) {
+    for (uint32_t i=0;i<n_streams;i++) {
+        if (streams[i].kind == kind && streams[i].id == id) return &streams[i];
+    }
+    if (n_streams == MAX_STREAMS) return NULL;
+    stream_t* s = &streams[n_streams++];
+    memset(s, 0, sizeof(*s));
+    s->kind = kind;
+    s->id = id;
+    return s;
+}
+
+static void decode_stream(stream_t* s) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s_%x%s", out_dir, log_kind_names[s->kind],
+            s->id, csv ? ".csv" : "");
+    FILE* fw = fopen(path, "w");
+    if (fw == NULL) {
+        printf("Unable to open %s\n", path);
+        return;
+    }
+    setvbuf(fw, NULL, _IOFBF, 1 << 20);
+    if (csv) {
+        fprintf(fw, "block,seq,cycle");
+        for (int w=2;w<16;w++) fprintf(fw, ",w%d", w);
+        fprintf(fw, "\n");
+    }
+    // The decoders take a mutable buffer; records are decoded in place from
+    // a private copy of each block
+    unsigned char* buf = NULL;
+    size_t buf_len = 0;
+    for (uint32_t b=0;b<s->n_blocks;b++) {
+        const log_block_hdr_t* hdr = s->blocks[b];
+        const unsigned char* records = (const unsigned char*) hdr + hdr->hdr_bytes;
+        size_t len = (size_t) hdr->n_records * LOG_RECORD_BYTES;
+        if (csv) {
+            const uint32_t* w = (const uint32_t*) records;
+            for (uint32_t r=0;r<hdr->n_records;r++, w+=16) {
+                fprintf(fw, "%u,%u,%u", b, w[0], w[1]);
+                for (int i=2;i<16;i++) fprintf(fw, ",%u", w[i]);
+                fprintf(fw, "\n");
+            }
+            continue;
+        }
+        if (len > buf_len) {
+            free(buf);
+            buf = (unsigned char*) malloc(len);
+            buf_len = len;
+        }
+        memcpy(buf, records, len);
+        write_log_header(s->kind, fw, hdr->log_size);
+        write_log(s->kind, buf, fw, hdr->n_records, hdr->id);
+    }
+    free(buf);
+    fclose(fw);
+}
+
+static void* worker(void* arg) {
+    while (true) {
+        int kind = __atomic_fetch_add(&next_kind, 1, __ATOMIC_RELAXED);
+        if (kind >= LOG_N_KINDS) break;
+        for (uint32_t i=0;i<n_streams;i++) {
+            if (streams[i].kind == kind) decode_stream(&streams[i]);
+        }
+    }
+    return NULL;
+}
+
+static int prefix(const char* pre, const char* str) {
+    return strncmp(pre, str, strlen(pre)) == 0;
+}
+
+int main(int argc, char** argv) {
+    int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int cur_arg = 1;
+    while (cur_arg < argc && prefix("--", argv[cur_arg])) {
+        const char* val = strchr(argv[cur_arg], '=');
+        val = val ? val + 1 : "";
+        if (prefix("--threads", argv[cur_arg])) n_threads = atoi(val);
+        if (prefix("--format", argv[cur_arg])) csv = (strcmp(val, "csv") == 0);
+        if (prefix("--out", argv[cur_arg])) out_dir = val;
+        cur_arg++;
+    }
+    if (cur_arg >= argc) {
+        printf("Usage: %s [--threads=N] [--format=text|csv] [--out=<dir>] <dump>\n", argv[0]);
+        exit(0);
+    }
+    const char* path = argv[cur_arg];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Unable to open %s\n", path);
+        exit(0);
+    }
+    size_t file_len = st.st_size;
+    if (file_len == 0) {
+        printf("%s is empty\n", path);
+        exit(0);
+    }
+    const unsigned char* file = (const unsigned char*) mmap(NULL, file_len,
+            PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        printf("Unable to mmap %s\n", path);
+        exit(0);
+    }
+
+    // Index the blocks
+    size_t offset = 0;
+    uint64_t n_blocks = 0;
+    while (offset + sizeof(log_block_hdr_t) <= file_len) {
+        const log_block_hdr_t* hdr = (const log_block_hdr_t*) (file + offset);
+        if (hdr->magic != LOG_BLOCK_MAGIC || hdr->kind >= LOG_N_KINDS ||
+                hdr->hdr_bytes < sizeof(log_block_hdr_t)) {
+            printf("Bad block header at offset %lu\n", offset);
+            break;
+        }
+        size_t len = hdr->hdr_bytes + (size_t) hdr->n_records * LOG_RECORD_BYTES;
+        if (offset + len > file_len) {
+            printf("Truncated block at offset %lu\n", offset);
+            break;
+        }
+        // same for all blocks of a run
+        if (n_blocks == 0) log_no_rollback = hdr->flags & LOG_FLAG_NO_ROLLBACK;
+        stream_t* s = get_stream(hdr->kind, hdr->id);
+        if (s == NULL) {
+            printf("Too many streams\n");
+            break;
+        }
+        if (s->n_blocks == s->cap_blocks) {
+            s->cap_blocks = s->cap_blocks ? s->cap_blocks * 2 : 64;
+            s->blocks = (const log_block_hdr_t**) realloc(s->blocks,
+                    s->cap_blocks * sizeof(log_block_hdr_t*));
+        }
+        s->blocks[s->n_blocks++] = hdr;
+        s->n_records += hdr->n_records;
+        n_blocks++;
+        offset += len;
+    }
+
+    if (n_threads < 1) n_threads = 1;
+    if (n_threads > LOG_N_KINDS) n_threads = LOG_N_KINDS;
+    pthread_t threads[LOG_N_KINDS];
+    for (int i=0;i<n_threads;i++) pthread_create(&threads[i], NULL, worker, NULL);
+    for (int i=0;i<n_threads;i++) pthread_join(threads[i], NULL);
+
+    printf("%lu blocks, %u streams\n", n_blocks, n_streams);
+    for (uint32_t i=0;i<n_streams;i++) {
+        printf("\t%s/%s_%x%s: %lu records in %u blocks\n", out_dir,
+                log_kind_names[streams[i].kind], streams[i].id, csv ? ".csv" : "",
+                streams[i].n_records, streams[i].n_blocks);
+        free(streams[i].blocks);
+    }
+    munmap((void*) file, file_len);
+    return 0;
+}
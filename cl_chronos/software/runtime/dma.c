@@ -0,0 +1,455 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host <-> FPGA DMA engine.
+//
+// Writes: transfers are cut into DMA_CHUNK_SIZE pieces aligned to the destination
+// address and handed out to one thread per XDMA H2C channel, so all channels
+// are kept busy on large uploads. Each call moves as much of its chunk as the
+// driver accepts; the transfer size is only reduced when the driver returns
+// short (and, after an error, retried at half size down to DMA_MIN_XFER).
+// Workers issue MADV_WILLNEED for the chunk DMA_READAHEAD_CHUNKS ahead of the
+// shared cursor, so with an mmap'd input the page cache is filled from disk
+// while earlier chunks are on the wire.
+//
+// Reads: dma_read_start() streams a region back over all C2H channels into a
+// ring of DMA_READ_SLOTS buffers (or in place, into a caller buffer), and
+// dma_read_next() hands the chunks to the caller in address order as they
+// complete, so results can be checked while later chunks are still in
+// flight. A ring slot is reused once the caller has released its chunk.
+
+#include "header.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define DMA_CHUNK_SIZE (8 << 20)
+#define DMA_MIN_XFER 512
+#define DMA_MAX_RETRIES 4
+#define DMA_READAHEAD_CHUNKS 4
+// Below this size, a transfer is not split across channels
+#define DMA_PARALLEL_THRESHOLD (2 * DMA_CHUNK_SIZE)
+#define DMA_READ_CHUNK_SIZE (4 << 20)
+#define DMA_READ_SLOTS (2 * DMA_MAX_CHANNELS)
+
+typedef struct {
+    int fd;
+    size_t max_xfer;      // current transfer size limit; shrinks on short writes
+    uint64_t bytes;
+    uint64_t calls;
+    uint64_t short_xfers;
+    uint64_t errors;
+    uint64_t busy_ns;
+} dma_channel_t;
+
+static dma_channel_t h2c[DMA_MAX_CHANNELS];
+static dma_channel_t c2h[DMA_MAX_CHANNELS];
+static int n_h2c = 0;
+static int n_c2h = 0;
+static uint64_t stats_start_ns;
+static uint64_t read_wait_ns;     // caller blocked in dma_read_next
+
+typedef struct {
+    const unsigned char* buf;
+    size_t len;
+    size_t addr;
+    size_t next;          // offset of the next chunk to hand out
+    int failed;
+} dma_job_t;
+
+typedef struct {
+    dma_job_t* job;
+    dma_channel_t* ch;
+} dma_worker_t;
+
+typedef struct {
+    dma_reader_t* rd;
+    dma_channel_t* ch;
+} dma_read_worker_t;
+
+struct dma_reader {
+    unsigned char* dst;   // caller buffer, or NULL to read into the ring
+    unsigned char* ring;
+    size_t len;
+    size_t addr;
+    size_t n_chunks;
+    size_t next_issue;    // next chunk to hand to a channel
+    size_t next_deliver;  // next chunk to hand to the caller
+    size_t released;      // chunks the caller is done with
+    size_t slot_done[DMA_READ_SLOTS]; // 1 + index of the chunk completed in a slot
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int n_threads;
+    pthread_t threads[DMA_MAX_CHANNELS];
+    dma_read_worker_t workers[DMA_MAX_CHANNELS];
+};
+
+static uint64_t dma_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Opens up to n_channels queues in one direction; returns the number opened.
+static int dma_open_channels(int slot_id, dma_channel_t* chs, int n_channels,
+        bool is_read) {
+    for (int i=0;i<n_channels;i++) {
+        memset(&chs[i], 0, sizeof(dma_channel_t));
+        chs[i].fd = fpga_dma_open_queue(FPGA_DMA_XDMA, slot_id,
+                /*channel*/ i, is_read);
+        if (chs[i].fd < 0) {
+            if (i > 0) {
+                printf("unable to open %s dma queue %d, using %d channels\n",
+                        is_read ? "read" : "write", i, i);
+            }
+            return i;
+        }
+        chs[i].max_xfer = DMA_CHUNK_SIZE;
+    }
+    return n_channels;
+}
+
+int dma_init(int slot_id, int n_channels) {
+    if (n_channels < 1) n_channels = 1;
+    if (n_channels > DMA_MAX_CHANNELS) n_channels = DMA_MAX_CHANNELS;
+    n_h2c = dma_open_channels(slot_id, h2c, n_channels, false);
+    if (n_h2c == 0) {
+        printf("unable to open write dma queue\n");
+        return 1;
+    }
+    n_c2h = dma_open_channels(slot_id, c2h, n_channels, true);
+    if (n_c2h == 0) {
+        printf("unable to open read dma queue\n");
+        return 1;
+    }
+    stats_start_ns = dma_now_ns();
+    return 0;
+}
+
+void dma_close() {
+    for (int i=0;i<n_h2c;i++) close(h2c[i].fd);
+    for (int i=0;i<n_c2h;i++) close(c2h[i].fd);
+    n_h2c = 0;
+    n_c2h = 0;
+}
+
+// fd of C2H channel 0, for the single-threaded readers (debug logs)
+int dma_read_fd() {
+    return (n_c2h > 0) ? c2h[0].fd : -1;
+}
+
+// Moves len bytes between buf and FPGA address addr on a single channel.
+static int dma_xfer_channel(dma_channel_t* ch, unsigned char* buf,
+        size_t len, size_t addr, bool is_read) {
+    size_t offset = 0;
+    int retries = 0;
+    uint64_t start = dma_now_ns();
+    while (offset < len) {
+        size_t xfer = len - offset;
+        if (xfer > ch->max_xfer) xfer = ch->max_xfer;
+        ssize_t rc = is_read ?
+            pread(ch->fd, buf + offset, xfer, addr + offset) :
+            pwrite(ch->fd, buf + offset, xfer, addr + offset);
+        ch->calls++;
+        if (rc <= 0) {
+            ch->errors++;
+            if (ch->max_xfer > DMA_MIN_XFER) {
+                ch->max_xfer = (ch->max_xfer / 2 < DMA_MIN_XFER) ?
+                    DMA_MIN_XFER : ch->max_xfer / 2;
+            } else if (++retries > DMA_MAX_RETRIES) {
+                // errno is only meaningful when the call itself failed
+                printf("call to %s failed at addr %lx (%s)\n",
+                        is_read ? "pread" : "pwrite", addr + offset,
+                        rc < 0 ? strerror(errno) : "short/zero transfer");
+                return -1;
+            }
+            continue;
+        }
+        if ((size_t) rc < xfer) {
+            // The driver moved less than asked; don't ask for more than it
+            // moves on this channel from now on.
+            ch->short_xfers++;
+            size_t limit = rc & ~(size_t)(DMA_MIN_XFER - 1);
+            ch->max_xfer = (limit < DMA_MIN_XFER) ? DMA_MIN_XFER : limit;
+        }
+        retries = 0;
+        offset += rc;
+    }
+    ch->bytes += len;
+    ch->busy_ns += dma_now_ns() - start;
+    return 0;
+}
+
+static void* dma_write_worker(void* arg) {
+    dma_worker_t* w = (dma_worker_t*) arg;
+    dma_job_t* job = w->job;
+    long page = sysconf(_SC_PAGESIZE);
+    while (!__atomic_load_n(&job->failed, __ATOMIC_RELAXED)) {
+        // Chunks end on DMA_CHUNK_SIZE boundaries of the destination address
+        size_t begin = __atomic_load_n(&job->next, __ATOMIC_RELAXED);
+        size_t end;
+        do {
+            if (begin >= job->len) return NULL;
+            end = ((job->addr + begin) / DMA_CHUNK_SIZE + 1) * DMA_CHUNK_SIZE
+                - job->addr;
+            if (end > job->len) end = job->len;
+        } while (!__atomic_compare_exchange_n(&job->next, &begin, end, false,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+        size_t ra = begin + DMA_READAHEAD_CHUNKS * DMA_CHUNK_SIZE;
+        if (ra < job->len) {
+            uintptr_t p = (uintptr_t) (job->buf + ra) & ~(uintptr_t) (page - 1);
+            size_t ra_len = DMA_CHUNK_SIZE;
+            if (ra + ra_len > job->len) ra_len = job->len - ra;
+            madvise((void*) p, ra_len + page, MADV_WILLNEED);
+        }
+        if (dma_xfer_channel(w->ch, (unsigned char*) job->buf + begin, end - begin,
+                    job->addr + begin, false)) {
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+int dma_write(const unsigned char* write_buffer, size_t write_len, size_t write_addr) {
+    if (n_h2c == 0) {
+        printf("dma_write: no DMA channels open\n");
+        return -1;
+    }
+    if (n_h2c == 1 || write_len < DMA_PARALLEL_THRESHOLD) {
+        return dma_xfer_channel(&h2c[0], (unsigned char*) write_buffer, write_len,
+                write_addr, false);
+    }
+    dma_job_t job = { write_buffer, write_len, write_addr, 0, 0 };
+    dma_worker_t workers[DMA_MAX_CHANNELS];
+    pthread_t threads[DMA_MAX_CHANNELS];
+    for (int i=0;i<n_h2c;i++) {
+        workers[i].job = &job;
+        workers[i].ch = &h2c[i];
+        if (pthread_create(&threads[i], NULL, dma_write_worker, &workers[i])) {
+            printf("dma_write: unable to start worker %d\n", i);
+            job.failed = 1;
+            for (int j=0;j<i;j++) pthread_join(threads[j], NULL);
+            return -1;
+        }
+    }
+    for (int i=0;i<n_h2c;i++) pthread_join(threads[i], NULL);
+    return job.failed ? -1 : 0;
+}
+
+int dma_n_channels(bool is_read) {
+    return is_read ? n_c2h : n_h2c;
+}
+
+// Moves len bytes on one channel, without splitting the transfer across
+// channels; for the link benchmarks.
+int dma_xfer(int channel, bool is_read, unsigned char* buf, size_t len,
+        size_t addr) {
+    if (channel >= dma_n_channels(is_read)) return -1;
+    return dma_xfer_channel(is_read ? &c2h[channel] : &h2c[channel], buf, len,
+            addr, is_read);
+}
+
+// Caps the size of every driver call on all channels, e.g. at DMA_MIN_XFER to
+// reproduce the 512 B chunking older shells needed. 0 restores the default.
+void dma_set_max_xfer(size_t max_xfer) {
+    if (max_xfer == 0 || max_xfer > DMA_CHUNK_SIZE) max_xfer = DMA_CHUNK_SIZE;
+    if (max_xfer < DMA_MIN_XFER) max_xfer = DMA_MIN_XFER;
+    for (int i=0;i<n_h2c;i++) h2c[i].max_xfer = max_xfer;
+    for (int i=0;i<n_c2h;i++) c2h[i].max_xfer = max_xfer;
+}
+
+static unsigned char* dma_read_buf(dma_reader_t* rd, size_t chunk) {
+    if (rd->dst) return rd->dst + chunk * DMA_READ_CHUNK_SIZE;
+    return rd->ring + (chunk % DMA_READ_SLOTS) * DMA_READ_CHUNK_SIZE;
+}
+
+static void* dma_read_worker(void* arg) {
+    dma_read_worker_t* w = (dma_read_worker_t*) arg;
+    dma_reader_t* rd = w->rd;
+    while (1) {
+        pthread_mutex_lock(&rd->lock);
+        while (!rd->failed && rd->next_issue < rd->n_chunks &&
+                rd->next_issue >= rd->released + DMA_READ_SLOTS) {
+            pthread_cond_wait(&rd->cond, &rd->lock);
+        }
+        if (rd->failed || rd->next_issue >= rd->n_chunks) {
+            pthread_mutex_unlock(&rd->lock);
+            return NULL;
+        }
+        size_t chunk = rd->next_issue++;
+        pthread_mutex_unlock(&rd->lock);
+
+        size_t offset = chunk * DMA_READ_CHUNK_SIZE;
+        size_t len = rd->len - offset;
+        if (len > DMA_READ_CHUNK_SIZE) len = DMA_READ_CHUNK_SIZE;
+        int rc = dma_xfer_channel(w->ch, dma_read_buf(rd, chunk), len,
+                rd->addr + offset, true);
+
+        pthread_mutex_lock(&rd->lock);
+        if (rc) rd->failed = 1;
+        else rd->slot_done[chunk % DMA_READ_SLOTS] = chunk + 1;
+        pthread_cond_broadcast(&rd->cond);
+        pthread_mutex_unlock(&rd->lock);
+    }
+}
+
+dma_reader_t* dma_read_start(unsigned char* dst, size_t len, size_t addr) {
+    if (n_c2h == 0) {
+        printf("dma_read_start: no DMA channels open\n");
+        return NULL;
+    }
+    dma_reader_t* rd = (dma_reader_t*) calloc(1, sizeof(dma_reader_t));
+    rd->dst = dst;
+    rd->len = len;
+    rd->addr = addr;
+    rd->n_chunks = (len + DMA_READ_CHUNK_SIZE - 1) / DMA_READ_CHUNK_SIZE;
+    if (dst == NULL) {
+        size_t slots = rd->n_chunks < DMA_READ_SLOTS ? rd->n_chunks : DMA_READ_SLOTS;
+        rd->ring = (unsigned char*) malloc(slots * DMA_READ_CHUNK_SIZE);
+    }
+    pthread_mutex_init(&rd->lock, NULL);
+    pthread_cond_init(&rd->cond, NULL);
+
+    int n_threads = (rd->n_chunks < n_c2h) ? rd->n_chunks : n_c2h;
+    for (int i=0;i<n_threads;i++) {
+        rd->workers[i].rd = rd;
+        rd->workers[i].ch = &c2h[i];
+        if (pthread_create(&rd->threads[i], NULL, dma_read_worker, &rd->workers[i])) {
+            printf("dma_read_start: unable to start worker %d\n", i);
+            rd->failed = 1;
+            break;
+        }
+        rd->n_threads++;
+    }
+    return rd;
+}
+
+// Blocks until the next chunk (in address order) has arrived. Returns false
+// once the whole region has been delivered, or on a DMA error.
+bool dma_read_next(dma_reader_t* rd, dma_chunk_t* chunk) {
+    uint64_t start = dma_now_ns();
+    pthread_mutex_lock(&rd->lock);
+    size_t c = rd->next_deliver;
+    while (!rd->failed && c < rd->n_chunks &&
+            rd->slot_done[c % DMA_READ_SLOTS] != c + 1) {
+        pthread_cond_wait(&rd->cond, &rd->lock);
+    }
+    read_wait_ns += dma_now_ns() - start;
+    bool ok = !rd->failed && c < rd->n_chunks;
+    if (ok) {
+        rd->next_deliver++;
+        chunk->index = c;
+        chunk->offset = c * DMA_READ_CHUNK_SIZE;
+        chunk->len = rd->len - chunk->offset;
+        if (chunk->len > DMA_READ_CHUNK_SIZE) chunk->len = DMA_READ_CHUNK_SIZE;
+        chunk->data = dma_read_buf(rd, c);
+    }
+    pthread_mutex_unlock(&rd->lock);
+    return ok;
+}
+
+// Returns the chunk's ring slot to the readers. Chunks are released in the
+// order they were delivered.
+void dma_read_release(dma_reader_t* rd, dma_chunk_t* chunk) {
+    pthread_mutex_lock(&rd->lock);
+    assert(chunk->index == rd->released);
+    rd->released++;
+    pthread_cond_broadcast(&rd->cond);
+    pthread_mutex_unlock(&rd->lock);
+}
+
+// Waits for the readers and frees the stream. Returns nonzero if any chunk
+// failed to transfer.
+int dma_read_finish(dma_reader_t* rd) {
+    pthread_mutex_lock(&rd->lock);
+    // Unblock readers waiting on ring space for chunks nobody will consume
+    if (rd->next_deliver < rd->n_chunks) rd->failed |= 2;
+    pthread_cond_broadcast(&rd->cond);
+    pthread_mutex_unlock(&rd->lock);
+    for (int i=0;i<rd->n_threads;i++) pthread_join(rd->threads[i], NULL);
+    int failed = rd->failed & 1;
+    pthread_mutex_destroy(&rd->lock);
+    pthread_cond_destroy(&rd->cond);
+    free(rd->ring);
+    free(rd);
+    return failed;
+}
+
+// Reads a whole region into dst before returning.
+int dma_read(unsigned char* dst, size_t len, size_t addr) {
+    dma_reader_t* rd = dma_read_start(dst, len, addr);
+    if (rd == NULL) return -1;
+    dma_chunk_t chunk;
+    while (dma_read_next(rd, &chunk)) dma_read_release(rd, &chunk);
+    return dma_read_finish(rd) ? -1 : 0;
+}
+
+static void dma_channel_stats_reset(dma_channel_t* ch) {
+    ch->bytes = 0;
+    ch->calls = 0;
+    ch->short_xfers = 0;
+    ch->errors = 0;
+    ch->busy_ns = 0;
+}
+
+void dma_stats_reset() {
+    stats_start_ns = dma_now_ns();
+    read_wait_ns = 0;
+    for (int i=0;i<n_h2c;i++) dma_channel_stats_reset(&h2c[i]);
+    for (int i=0;i<n_c2h;i++) dma_channel_stats_reset(&c2h[i]);
+}
+
+static uint64_t dma_channel_stats(const char* label, const char* dir,
+        dma_channel_t* chs, int n) {
+    uint64_t total = 0;
+    for (int i=0;i<n;i++) {
+        dma_channel_t* ch = &chs[i];
+        total += ch->bytes;
+        if (ch->calls == 0) continue;
+        printf("%s: %s %d %10lu bytes %6.3f GB/s calls:%lu short:%lu errors:%lu\n",
+                label, dir, i, ch->bytes,
+                ch->busy_ns ? (double) ch->bytes / ch->busy_ns : 0.0,
+                ch->calls, ch->short_xfers, ch->errors);
+    }
+    return total;
+}
+
+// Time spent waiting for chunks in dma_read_next() since the last
+// dma_stats_reset(), i.e. the part of a streamed read the caller could not
+// overlap with its own processing.
+uint64_t dma_read_wait_ns() {
+    return read_wait_ns;
+}
+
+// Prints achieved bandwidth per channel (bytes over the time that channel
+// was busy) and overall (over wall time) since the last dma_stats_reset().
+void dma_stats(const char* label) {
+    uint64_t elapsed_ns = dma_now_ns() - stats_start_ns;
+    uint64_t total = dma_channel_stats(label, "h2c", h2c, n_h2c);
+    total += dma_channel_stats(label, "c2h", c2h, n_c2h);
+    printf("%s: total %lu bytes in %.3f ms, %.3f GB/s\n", label, total,
+            elapsed_ns / 1e6, elapsed_ns ? (double) total / elapsed_ns : 0.0);
+}
@@ -41,10 +41,31 @@
 #include <math.h>
 #include <poll.h>
 #include <assert.h>
+#include <time.h>
+
+#include "log_decode.h"
+#include "tsb_map.h"
+
+// Loads and stores to a BAR0 mapped by pci_map_bar(). The software model
+// (sim/include/fpga_pci.h) provides its own.
+#ifndef OCL_MMIO_READ
+#define OCL_MMIO_READ(p) (*(p))
+#define OCL_MMIO_WRITE(p, v) (*(p) = (v))
+#endif
+#define OCL_BAR_SIZE (1 << 24)  // {tile, component, register}
 
 #define LOG_SPLITTERS_PER_CHUNK           4
 #define ADDR_BASE_SPILL                   (1<<30)
 #define LOG_SPLITTER_STACK_SIZE           14
+// Splitter stack depth the spill unit is actually built with
+// (design/spill_config.vh); XSIM builds use a smaller stack.
+#ifndef HW_LOG_SPLITTER_STACK_SIZE
+#ifdef XILINX_SIMULATOR
+#define HW_LOG_SPLITTER_STACK_SIZE        9
+#else
+#define HW_LOG_SPLITTER_STACK_SIZE        12
+#endif
+#endif
 #define LOG_SPLITTER_STACK_ENTRY_WIDTH    4
 #define LOG_SPLITTER_CHUNK_WIDTH           (7 - 3 + 3)
 #define LOG_SPLITTER_ENTRIES     (LOG_SPLITTER_STACK_SIZE + LOG_SPLITTERS_PER_CHUNK)
@@ -248,10 +269,17 @@
 #define L2_RETRY_NOT_EMPTY 0x38
 #define L2_RETRY_COUNT     0x3c
 #define L2_STALL_IN        0x40
+#define L2_PREFETCH_HITS   0x44
+#define L2_PREFETCH_MISSES 0x48
 #define L2_DEBUG_WORD      0x50
 
 #define L2_LOG_BVALID        0x14
 #define L2_CIRCULATE_ON_STALL 0x18
+#define L2_PREFETCH_CAPACITY 0x1c
+
+// Prefetcher of the non-pipelined cores, on the ID_RW_READ register bus
+#define PREFETCHER_BASE_ADDR   0x20
+#define PREFETCHER_OBJECT_SIZE 0x24
 
 #define DEBUG_CAPACITY    0xf0 // For any component that does logging
 
@@ -272,22 +300,223 @@ int log_serializer(pci_bar_handle_t pci_bar_handle, int fd, FILE* fw, unsigned c
 int log_ro_stage(pci_bar_handle_t pci_bar_handle, int fd, FILE* fw, unsigned char*, uint32_t);
 int log_rw_stage(pci_bar_handle_t pci_bar_handle, int fd, FILE* fw, unsigned char*, uint32_t);
 int log_undo_log(pci_bar_handle_t pci_bar_handle, int fd, FILE* fw, unsigned char*, uint32_t);
-void write_task_unit_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size, uint32_t tile_id);
+int log_raw_open(const char* path);
+void log_raw_close();
+bool log_raw_enabled();
+void log_raw_write(const void* blocks, size_t len);
+void log_block_init(log_block_hdr_t* hdr, log_kind_t kind, uint32_t ID,
+        uint32_t log_size, uint32_t n_records);
 
 void init_params();
 void pci_poke(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t data);
 void pci_peek(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t* data);
+void pci_config(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t data);
+extern uint32_t pci_config_writes, pci_config_skipped;
+int pci_map_bar();
+void pci_unmap_bar();
+void pci_batch_begin();
+int pci_batch_end();
 void task_unit_stats(uint32_t tile, uint32_t);
 void serializer_stats(uint32_t tile, uint32_t);
 void cq_stats (uint32_t tile, uint32_t);
 void core_stats (uint32_t tile, uint32_t);
 extern pci_bar_handle_t pci_bar_handle;
-void dma_write(unsigned char* write_buffer, uint32_t write_len, size_t write_addr);
+
+// dma.c
+#define DMA_MAX_CHANNELS 4
+int dma_init(int slot_id, int n_channels);
+void dma_close();
+int dma_write(const unsigned char* write_buffer, size_t write_len, size_t write_addr);
+void dma_stats_reset();
+void dma_stats(const char* label);
+int dma_read_fd();
+int dma_n_channels(bool is_read);
+int dma_xfer(int channel, bool is_read, unsigned char* buf, size_t len,
+        size_t addr);
+void dma_set_max_xfer(size_t max_xfer);
+
+typedef struct dma_reader dma_reader_t;
+typedef struct {
+    unsigned char* data;
+    size_t index;
+    size_t offset;        // from the start of the region
+    size_t len;
+} dma_chunk_t;
+dma_reader_t* dma_read_start(unsigned char* dst, size_t len, size_t addr);
+bool dma_read_next(dma_reader_t* rd, dma_chunk_t* chunk);
+void dma_read_release(dma_reader_t* rd, dma_chunk_t* chunk);
+int dma_read_finish(dma_reader_t* rd);
+int dma_read(unsigned char* dst, size_t len, size_t addr);
+uint64_t dma_read_wait_ns();
+
+typedef struct {
+    unsigned char* data;  // input image, as it should be laid out in DDR
+    size_t len;           // bytes of data to transfer
+    size_t map_len;       // size of the mapping backing data
+    uint32_t* headers;    // == data; patched in place (copy-on-write)
+    bool binary;
+} chronos_input_t;
+
+int load_input(const char* path, chronos_input_t* in, bool populate, bool hugepages);
+void unload_input(chronos_input_t* in);
+
+// bulk_enq.c
+typedef struct {
+    uint32_t ttype;
+    uint32_t ts;
+    uint32_t object;
+    uint32_t args[4];
+} init_task_t;
+
+// Widths of the app-dependent task_t fields (N_TASK_TYPES, ARG_WIDTH)
+typedef struct {
+    uint32_t ttype_bits;
+    uint32_t arg_bits;
+} task_fmt_t;
+
+int bulk_enqueue(const init_task_t* tasks, size_t n_tasks, const task_fmt_t* fmt,
+        uint32_t n_tiles, bool use_hash);
+
+// stats.c
+typedef struct {
+    const char* name;
+    uint32_t* comp;       // component ID variable, see init_params()
+    uint32_t addr;        // MSB for 64-bit counters
+    uint32_t addr_lsb;
+    uint8_t width;
+    bool cumulative;      // event counter, as opposed to an instantaneous value
+} stat_reg_t;
+extern const stat_reg_t stat_regs[];
+extern const uint32_t n_stat_regs;
+
+typedef struct {
+    uint32_t n_tiles;
+    uint64_t cycle;       // OCL_CUR_CYCLE when the snapshot was taken
+    uint64_t* values;     // [tile * n_stat_regs + reg]
+} stat_snapshot_t;
+
+int stat_reg_lookup(const char* name);
+uint64_t stat_read(uint32_t tile, const stat_reg_t* reg);
+void stat_snapshot(stat_snapshot_t* s, uint32_t n_tiles);
+void stat_snapshot_free(stat_snapshot_t* s);
+void stat_snapshot_delta(stat_snapshot_t* d, const stat_snapshot_t* after,
+        const stat_snapshot_t* before);
+uint64_t stat_value(const stat_snapshot_t* s, uint32_t tile, const char* name);
+uint64_t stat_total(const stat_snapshot_t* s, const char* name);
+int stat_write_json(const char* path, const stat_snapshot_t* s, uint64_t cycles,
+        const char* app);
+int stat_wait_quiet(uint32_t n_tiles, uint32_t timeout_us);
+
+// log_stream.c
+typedef struct {
+    log_kind_t kind;
+    uint32_t id;    // {tile, component}, as passed to log_<kind>
+    FILE* fw;       // decoded output; unused with --log_raw
+} log_source_t;
+int log_stream_start(int fd, const log_source_t* sources, uint32_t n_sources,
+        uint32_t watermark);
+void log_stream_stop();
+
+// params.c
+enum {
+    PARAM_SPILL_THRESHOLD,
+    PARAM_TIED_CAP,
+    PARAM_CLEAN_THRESHOLD,
+    PARAM_SPILL_SIZE,
+    PARAM_DEQ_TOLERANCE,
+    PARAM_PRE_ENQ_FIFO_THRESH,
+    PARAM_PRODUCER_THRESHOLD,
+    PARAM_COLOR_CHUNK,
+    PARAM_GR_INTERVAL_BIAS,
+    PARAM_PREFETCH_CAPACITY,
+    N_PARAMS
+};
+typedef struct {
+    const char* name;
+    const char* desc;
+    uint32_t value;
+    bool set;             // given explicitly or by a tuned configuration
+    bool valid;           // has a default for this app
+} param_t;
+extern param_t params[N_PARAMS];
+
+int param_parse_option(const char* arg);
+int param_load_config(const char* path);
+int param_load_tuned(const char* path, const char* app, const char* cls);
+void param_default(int id, uint32_t value);
+bool param_valid(int id);
+uint32_t param(int id);
+void param_print();
+void input_class(char* buf, size_t len, const uint32_t* headers);
+
+// daemon.c
+#define DAEMON_SOCKET "/tmp/chronos.sock"
+#define RESIDENT_SHADOW_SIZE 8192
+#define RESIDENT_FILES 16
+
+typedef struct {
+    uint64_t dev, ino, size, mtime_ns;
+    uint64_t hash;
+} resident_file_t;
+
+// State the daemon keeps across jobs, in memory shared with the job processes
+typedef struct {
+    bool busy;            // a job has started and not (yet) completed
+    bool valid;           // DDR holds the input below; its arrays need a reset
+    uint64_t hash;
+    size_t len;
+    int app;
+    uint32_t next_file;
+    resident_file_t files[RESIDENT_FILES];  // content hashes of recent inputs
+    uint64_t shadow[RESIDENT_SHADOW_SIZE];  // {1, OCL addr, value}, 0 if empty
+} resident_t;
+extern resident_t* resident;  // NULL unless running under the daemon
+
+int attach_slot(int slot_id, int pf_id, int bar_id);
+int parse_options(int argc, char** argv, int cur_arg);
+int run_app(int slot_id, int argc, char** argv, int cur_arg);
+int daemon_run(int slot_id, const char* path);
+int l2_flush(uint32_t n_tiles, uint32_t timeout_us);
+uint64_t resident_hash(const char* path, const chronos_input_t* in);
+int resident_upload(int app, const chronos_input_t* in, uint64_t hash);
+void resident_shadow_store(uint32_t ocl_addr, uint32_t data);
+bool resident_shadow_match(uint32_t ocl_addr, uint32_t data);
+
+// query.c
+int run_queries(const char* path, const char* out_path, int app,
+        const chronos_input_t* in, uint32_t n_tiles, uint32_t core_mask);
+
+// bench.c
+int bench_run(int slot_id, int pf_id, int bar_id, const char* path,
+        const char* sizes, uint32_t total_mb, uint32_t ocl_reps, int n_channels);
+
+// controller.c
+int controller_start(const char* path, uint32_t n_tiles, uint32_t interval_ms,
+        double target_pct, uint32_t margin, uint32_t max_running,
+        uint32_t running_cap);
+void controller_stop();
+
+// timers.c
+uint64_t timer_ns();
+void stage_begin(const char* name);
+void stage_end();
+void stage_move(const char* from, const char* to, uint64_t ns);
+void stage_print(uint64_t cycles, double clock_mhz);
+int stage_write_json(const char* path, const char* app, uint64_t cycles,
+        double clock_mhz);
+void fpga_clock_start();
+double fpga_clock_mhz();
+
+// telemetry.c
+int telemetry_start(const char* path, const char* regs, uint32_t interval_us,
+        uint32_t n_tiles);
+void telemetry_stop();
 
 void loop_debuggin_spec(uint32_t iters);
 void loop_debuggin_nonspec(uint32_t iters);
 
 extern uint32_t N_TILES;
+extern uint32_t APP_ID;
 extern uint32_t ID_OCL_SLAVE;
 extern uint32_t N_SSSP_CORES;
 extern uint32_t N_CORES;
@@ -301,10 +530,14 @@ extern uint32_t ID_MEM_ARB;
 extern uint32_t ID_PCI_ARB;
 extern uint32_t ID_TSB;
 extern uint32_t ID_CQ;
+extern uint32_t ID_L2_RW;
+extern uint32_t ID_L2_RO;
+extern uint32_t ID_SERIALIZER;
 extern uint32_t ID_LAST;
 extern uint32_t LOG_TQ_SIZE, LOG_CQ_SIZE;
 extern uint32_t TQ_STAGES, SPILLQ_STAGES;
 extern uint32_t NO_ROLLBACK;
+extern double clock_mhz;
 
 /*
  * pci_vendor_id and pci_device_id values below are Amazon's and avaliable to use for a given FPGA slot.
@@ -321,6 +554,7 @@ extern uint16_t pci_device_id; /* PCI Device ID preassigned by Amazon for F1 app
 #define APP_SILO 6
 #define APP_RBP 7
 #define APP_LAST 8
+extern const char* app_names[APP_LAST];
 
 typedef struct {
    uint excess;
@@ -0,0 +1,176 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Input loading for test_chronos.
+//
+// Binary inputs (first word 0xdead) are mmap'd MAP_PRIVATE and handed to the
+// DMA engine directly; the runtime's header patches only dirty (copy-on-write)
+// the first page, so host memory use is independent of the input size beyond
+// the page cache. Text inputs (one %08x word per line, as written by the HLS
+// testbenches) are converted into an anonymous mapping sized from the file,
+// eight hex digits at a time.
+
+#define _GNU_SOURCE
+#include "header.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ONES 0x0101010101010101ull
+#define HIGH 0x8080808080808080ull
+// per-byte (x >= n), for bytes of x < 0x80 and n <= 0x80. Result in bit 7.
+#define BYTES_GE(x, n) (((x) + ONES * (0x80 - (n))) & HIGH)
+
+// Parses 8 ASCII hex digits at p into *out. Returns false if any of them is
+// not a hex digit.
+static inline bool parse_hex8(const char* p, uint32_t* out) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    if (v & HIGH) return false;
+    uint64_t lower = v | (ONES * 0x20);
+    uint64_t digit = BYTES_GE(v, 0x30) & ~BYTES_GE(v, 0x3a);
+    uint64_t letter = BYTES_GE(lower, 0x61) & ~BYTES_GE(lower, 0x67);
+    if ((digit | letter) != HIGH) return false;
+
+    // nibble per byte; char 0 is in the least significant byte
+    uint64_t nib = (v & (ONES * 0x0f)) + (letter >> 7) * 9;
+    // byte 2k <- (n[2k] << 4) | n[2k+1]
+    nib = ((nib << 4) | (nib >> 8)) & 0x00ff00ff00ff00ffull;
+    // 16b lane 2k <- (b[2k] << 8) | b[2k+2]
+    nib = ((nib << 8) | (nib >> 16)) & 0x0000ffff0000ffffull;
+    *out = (uint32_t) (((nib & 0xffff) << 16) | ((nib >> 32) & 0xffff));
+    return true;
+}
+
+static inline uint32_t hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return 16;
+}
+
+// Same semantics as repeated fscanf("%8x\n"): skip whitespace, read up to 8
+// hex digits per word. Returns the number of words written to out.
+static size_t parse_hex_text(const char* p, size_t len, uint32_t* out) {
+    const char* end = p + len;
+    size_t n = 0;
+    while (p < end) {
+        // Fast path: "xxxxxxxx\n"
+        if (end - p >= 9 && p[8] == '\n' && parse_hex8(p, &out[n])) {
+            n++;
+            p += 9;
+            continue;
+        }
+        if (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+            p++;
+            continue;
+        }
+        uint32_t word = 0;
+        int digits = 0;
+        while (p < end && digits < 8 && hex_val(*p) < 16) {
+            word = (word << 4) | hex_val(*p);
+            p++;
+            digits++;
+        }
+        if (digits == 0) {
+            printf("Invalid character in input at offset %ld\n", (long) (len - (end - p)));
+            break;
+        }
+        out[n++] = word;
+    }
+    return n;
+}
+
+int load_input(const char* path, chronos_input_t* in, bool populate, bool hugepages) {
+    memset(in, 0, sizeof(*in));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Unable to open input file %s\n", path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        printf("Unable to read input file %s\n", path);
+        close(fd);
+        return 1;
+    }
+    size_t file_len = st.st_size;
+    int flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+    unsigned char* file = (unsigned char*) mmap(NULL, file_len,
+            PROT_READ | PROT_WRITE, flags, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        printf("Unable to mmap input file %s\n", path);
+        return 1;
+    }
+    madvise(file, file_len, MADV_SEQUENTIAL);
+
+    uint32_t magic_op = *(uint32_t*) file;
+    printf("MAGIC_OP %x\n", magic_op);
+    in->binary = (magic_op == 0xdead);
+    if (in->binary) {
+        in->data = file;
+        in->len = file_len;
+        in->map_len = file_len;
+    } else {
+        // Each word takes at least two characters ("x\n")
+        size_t max_len = ((file_len / 2 + 1) * 4 + 4095) & ~4095ul;
+        int anon_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+        unsigned char* buf = MAP_FAILED;
+        if (hugepages) {
+            size_t huge_len = (max_len + (2 << 20) - 1) & ~((2ul << 20) - 1);
+            buf = (unsigned char*) mmap(NULL, huge_len, PROT_READ | PROT_WRITE,
+                    anon_flags | MAP_HUGETLB, -1, 0);
+            if (buf != MAP_FAILED) max_len = huge_len;
+        }
+        if (buf == MAP_FAILED) {
+            buf = (unsigned char*) mmap(NULL, max_len, PROT_READ | PROT_WRITE,
+                    anon_flags, -1, 0);
+            if (buf == MAP_FAILED) {
+                printf("Unable to allocate %lu bytes for input\n", max_len);
+                munmap(file, file_len);
+                return 1;
+            }
+            if (hugepages) madvise(buf, max_len, MADV_HUGEPAGE);
+        }
+        size_t n = parse_hex_text((const char*) file, file_len, (uint32_t*) buf);
+        munmap(file, file_len);
+        in->data = buf;
+        in->len = n * 4;
+        in->map_len = max_len;
+        printf("File Len %lu\n", in->len);
+    }
+    if (in->len < 64) {
+        printf("Input file %s too short (%lu bytes)\n", path, in->len);
+        unload_input(in);
+        return 1;
+    }
+    in->headers = (uint32_t*) in->data;
+    return 0;
+}
+
+void unload_input(chronos_input_t* in) {
+    if (in->data != NULL) munmap(in->data, in->map_len);
+    in->data = NULL;
+    in->headers = NULL;
+}
@@ -0,0 +1,91 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Debug log record decoders (log_decode.c) and the raw dump format. Does not
+// depend on the FPGA SDK, so that the offline decoder builds anywhere.
+
+#ifndef LOG_DECODE_H
+#define LOG_DECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LOG_RECORD_BYTES 64
+
+typedef enum {
+    LOG_TASK_UNIT,
+    LOG_UNDO_LOG,
+    LOG_CACHE,
+    LOG_SPLITTER,
+    LOG_COALESCER,
+    LOG_CQ,
+    LOG_DDR,
+    LOG_AXI,
+    LOG_RW_STAGE,
+    LOG_RO_STAGE,
+    LOG_SERIALIZER,
+    LOG_RISCV,
+    LOG_PCI,
+    LOG_N_KINDS
+} log_kind_t;
+
+extern const char* log_kind_names[LOG_N_KINDS];
+
+// A raw dump (--log_raw) is a sequence of blocks, one per drain of a
+// component's log: a header followed by n_records 64-byte records, exactly as
+// read from the FPGA.
+#define LOG_BLOCK_MAGIC 0x474c4843 // "CHLG"
+typedef struct {
+    uint32_t magic;
+    uint16_t kind;        // log_kind_t
+    uint16_t hdr_bytes;   // sizeof(log_block_hdr_t)
+    uint32_t id;          // (tile << 8) | component, as passed to log_*()
+    uint32_t log_size;    // DEBUG_CAPACITY at the start of the drain
+    uint32_t n_records;
+    uint32_t flags;       // LOG_FLAG_*
+    uint64_t host_ns;     // CLOCK_MONOTONIC at the start of the drain
+} log_block_hdr_t;
+#define LOG_FLAG_NO_ROLLBACK 1
+
+extern bool log_no_rollback;
+
+void write_log_header(log_kind_t kind, FILE* fw, uint32_t log_size);
+void write_log(log_kind_t kind, unsigned char* log_buffer, FILE* fw,
+        uint32_t log_size, uint32_t ID);
+
+void write_task_unit_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size, uint32_t tile_id);
+void write_undo_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_cache_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_splitter_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_coalescer_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_cq_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_ddr_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_axi_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_rw_stage_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_ro_stage_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_serializer_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_riscv_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+void write_pci_log(unsigned char* log_buffer, FILE* fw, uint32_t log_size);
+
+#endif
@@ -0,0 +1,275 @@
+import re
+
+# Task lifecycles from decoded task unit and CQ logs (task_unit_log and
+# cq_log, or the task_unit_* and cq_* files written by decode_logs), shared by
+# trace_export.py and abort_report.py. Undo logs can be given too; their
+# rollbacks are reported as 'restore' events.
+#
+# A log file is taken to be from the tile given after '@' (file@tile), else
+# from the id in a decode_logs file name (<kind>_<id>, tile = id >> 8), else
+# from tile 0.
+#
+# Tasks are identified by their task queue slot; task_deq links it to the CQ
+# slot used by start_task and finish_task. An aborted task is requeued in the
+# same slot, so one task can span several executions. The logs do not name
+# the parent of an enqueue, so it is inferred: a task that finishes with N
+# children is given the N earliest unclaimed tied enqueues made on its tile
+# while it ran, with a ts no lower than its own.
+
+line_re = re.compile(r'^\[\s*(\d+)\]\[\s*(\d+)\]')
+enq_re = re.compile(r'task_enqueue slot:\s*(\d+) ts:\s*([0-9a-f]+) object:\s*([0-9a-f]+) ttype:(\d+)(?:.* tied:(\d))?')
+deq_re = re.compile(r'task_deq\s+slot:\s*(\d+) ts:\s*(\w+) object:\s*(\w+) cq_slot\s+(\d+)')
+tq_re = re.compile(r'(commit_task|abort_task|abort_child|overflow)\s+slot:\s*(\d+)')
+start_re = re.compile(r'start_task\s+slot:\s*(\d+) core:\s*(\d+)')
+finish_re = re.compile(r'finish_task\s+slot:\s*(\d+) children:\s*(\d+)')
+to_tq_abort_re = re.compile(r'to_tq_abort ready:(\d) resource:(\d)')
+restore_re = re.compile(r'restore rvalid:([0-9a-f]+) slot:\s*(\d+)')
+n_tasks_re = re.compile(r'\]\s+\(\s*(\d+):\s*(\d+):\s*(\d+)\)')
+
+# Order of events logged in the same cycle
+PRIO = {'enq': 0, 'deq': 1, 'start': 2, 'finish': 3, 'to_tq_abort': 4,
+        'commit_task': 5, 'abort_task': 5, 'abort_child': 5, 'overflow': 5,
+        'restore': 6, 'n_tasks': 7}
+
+def parse_file(path, tile, events):
+    # Cycles are 32 bits; unwrap them, assuming consecutive records are less
+    # than 2^31 cycles apart.
+    offset = 0
+    last = 0
+    no_rollback = False
+    for line in open(path):
+        m = line_re.match(line)
+        if m is None:
+            continue
+        seq = int(m.group(1))
+        cycle = int(m.group(2))
+        if cycle + (1 << 31) < last:
+            offset += 1 << 32
+        last = cycle
+        cycle += offset
+        if line[m.end():].startswith('[]'):
+            no_rollback = True
+
+        m = enq_re.search(line)
+        if m:
+            events.append((tile, cycle, PRIO['enq'], seq, 'enq',
+                (int(m.group(1)), int(m.group(2), 16), int(m.group(3), 16),
+                 int(m.group(4)), m.group(5) == '1')))
+        m = deq_re.search(line)
+        if m:
+            # without rollback, task_deq prints ts and object in decimal
+            base = 10 if no_rollback else 16
+            events.append((tile, cycle, PRIO['deq'], seq, 'deq',
+                (int(m.group(1)), int(m.group(2), base),
+                 int(m.group(3), base), int(m.group(4)))))
+        m = tq_re.search(line)
+        if m:
+            events.append((tile, cycle, PRIO[m.group(1)], seq, m.group(1),
+                (int(m.group(2)),)))
+        m = start_re.search(line)
+        if m:
+            events.append((tile, cycle, PRIO['start'], seq, 'start',
+                (int(m.group(1)), int(m.group(2)))))
+        m = finish_re.search(line)
+        if m:
+            events.append((tile, cycle, PRIO['finish'], seq, 'finish',
+                (int(m.group(1)), int(m.group(2)))))
+        m = to_tq_abort_re.search(line)
+        if m and m.group(1) == '1':
+            events.append((tile, cycle, PRIO['to_tq_abort'], seq,
+                'to_tq_abort', (m.group(2) == '1',)))
+        m = restore_re.search(line)
+        if m:
+            events.append((tile, cycle, PRIO['restore'], seq, 'restore',
+                (int(m.group(2)), bin(int(m.group(1), 16)).count('1'))))
+        m = n_tasks_re.search(line)
+        if m:
+            events.append((tile, cycle, PRIO['n_tasks'], seq, 'n_tasks',
+                (int(m.group(1)), int(m.group(2)))))
+
+# Parses log[@tile] arguments; returns the events of all of them in order.
+def load(args):
+    events = []
+    for arg in args:
+        path, _, tile = arg.partition('@')
+        if tile == '':
+            m = re.search(r'_([0-9a-f]+)$', path)
+            tile = (int(m.group(1), 16) >> 8) if m else 0
+        parse_file(path, int(tile), events)
+    events.sort(key=lambda ev: ev[:4])
+    return events
+
+class Task:
+    def __init__(self, uid, tile, slot, cycle, ts, obj, ttype, tied):
+        self.uid = uid
+        self.tile = tile
+        self.slot = slot
+        self.enq_cycle = cycle
+        self.ts = ts
+        self.obj = obj
+        self.ttype = ttype
+        self.tied = tied
+        self.parent = None      # Exec that enqueued this task
+        self.first_exec = None
+        self.cur_exec = None
+        self.done = False
+
+    def name(self):
+        return 'ttype %d ts %x' % (self.ttype, self.ts)
+
+class Exec:
+    def __init__(self, task, cq_slot):
+        self.task = task
+        self.cq_slot = cq_slot
+        self.core = None
+        self.start = None
+        self.end = None
+        self.outcome = None
+
+    def cycles(self):
+        if self.start is None or self.end is None:
+            return 0
+        return self.end - self.start
+
+# Follows tasks through the events; subclasses override the hooks.
+class Lifecycle:
+    def __init__(self):
+        self.tasks = []
+        self.tq = {}        # (tile, tq slot) -> Task
+        self.cq = {}        # (tile, cq slot) -> Exec
+        self.pending = {}   # tile -> tied Tasks not yet claimed by a parent
+        self.cores = set()
+        self.tiles = set()
+        self.n_execs = 0
+        self.n_aborts = 0
+        self.last_deq = {}  # tile -> last Exec dequeued
+
+    # Hooks
+    def task_begin(self, t, cycle):
+        pass
+
+    def exec_end(self, e):
+        pass
+
+    def task_end(self, t, cycle, outcome):
+        pass
+
+    # e is the execution the abort ended, if any
+    def task_abort(self, t, e, cycle):
+        pass
+
+    # overflow, n_tasks, to_tq_abort, restore
+    def other(self, tile, cycle, kind, a):
+        pass
+
+    def new_task(self, tile, slot, cycle, ts, obj, ttype, tied):
+        old = self.tq.get((tile, slot))
+        if old is not None:
+            # slot reused; the end of the old task was not logged
+            self.end_task(old, cycle, 'unknown')
+        t = Task(len(self.tasks) + 1, tile, slot, cycle, ts, obj, ttype, tied)
+        self.tasks.append(t)
+        self.tq[(tile, slot)] = t
+        self.task_begin(t, cycle)
+        return t
+
+    def end_exec(self, e, cycle, outcome):
+        if e.outcome is not None:
+            return
+        e.outcome = outcome
+        if self.cq.get((e.task.tile, e.cq_slot)) is e:
+            del self.cq[(e.task.tile, e.cq_slot)]
+        if e.start is not None and e.end is None:
+            e.end = cycle
+        self.exec_end(e)
+
+    def end_task(self, t, cycle, outcome):
+        if t.cur_exec is not None:
+            self.end_exec(t.cur_exec, cycle, outcome)
+            t.cur_exec = None
+        t.done = True
+        self.task_end(t, cycle, outcome)
+        if self.tq.get((t.tile, t.slot)) is t:
+            del self.tq[(t.tile, t.slot)]
+
+    def claim_children(self, e, n_children):
+        tile = e.task.tile
+        keep = []
+        # Enqueues older than every running execution cannot be claimed
+        oldest = min([x.start for (k, x) in self.cq.items()
+                      if k[0] == tile and x.start is not None] + [e.start])
+        for c in self.pending.get(tile, []):
+            if (n_children > 0 and c.enq_cycle >= e.start and
+                    c.enq_cycle <= e.end and c.ts >= e.task.ts):
+                c.parent = e
+                n_children -= 1
+            elif c.enq_cycle >= oldest and not c.done:
+                keep.append(c)
+        self.pending[tile] = keep
+
+    def event(self, tile, cycle, kind, a):
+        self.tiles.add(tile)
+        if kind == 'enq':
+            slot, ts, obj, ttype, tied = a
+            t = self.new_task(tile, slot, cycle, ts, obj, ttype, tied)
+            if tied:
+                self.pending.setdefault(tile, []).append(t)
+        elif kind == 'deq':
+            slot, ts, obj, cq_slot = a
+            t = self.tq.get((tile, slot))
+            if t is None:
+                # enqueued before the log starts
+                t = self.new_task(tile, slot, cycle, ts, obj, 0, False)
+            old = self.cq.get((tile, cq_slot))
+            if old is not None:
+                self.end_exec(old, cycle, 'unknown')
+            e = Exec(t, cq_slot)
+            self.n_execs += 1
+            t.cur_exec = e
+            if t.first_exec is None:
+                t.first_exec = e
+            self.cq[(tile, cq_slot)] = e
+            self.last_deq[tile] = e
+        elif kind == 'start':
+            cq_slot, core = a
+            e = self.cq.get((tile, cq_slot))
+            if e is not None and e.start is None:
+                e.core = core
+                e.start = cycle
+                self.cores.add((tile, core))
+        elif kind == 'finish':
+            cq_slot, n_children = a
+            e = self.cq.get((tile, cq_slot))
+            if e is not None and e.start is not None and e.end is None:
+                e.end = cycle
+                self.claim_children(e, n_children)
+        elif kind == 'commit_task' or kind == 'abort_child':
+            t = self.tq.get((tile, a[0]))
+            if t is not None:
+                self.end_task(t, cycle,
+                        'commit' if kind == 'commit_task' else 'abort_child')
+        elif kind == 'abort_task':
+            t = self.tq.get((tile, a[0]))
+            if t is None:
+                return
+            self.n_aborts += 1
+            # requeued; a later task_deq starts a new execution
+            e = t.cur_exec
+            if e is not None:
+                self.end_exec(e, cycle, 'abort')
+                t.cur_exec = None
+            self.task_abort(t, e, cycle)
+        else:
+            self.other(tile, cycle, kind, a)
+
+    # Ends whatever is still open when the logs end
+    def finish(self, last_cycle):
+        for t in list(self.tq.values()):
+            self.end_task(t, last_cycle, 'unfinished')
+        for e in list(self.cq.values()):
+            self.end_exec(e, last_cycle, 'unfinished')
+
+    def run(self, events):
+        for (tile, cycle, prio, seq, kind, a) in events:
+            self.event(tile, cycle, kind, a)
+        self.finish(events[-1][1] if events else 0)
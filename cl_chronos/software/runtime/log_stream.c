@@ -0,0 +1,325 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Continuous debug log capture (--logging=1 --log_async=1).
+//
+// Instead of pausing the cores every logging_phase_tasks dequeues to empty
+// the on-chip logs, a drain thread polls DEBUG_CAPACITY of each logged
+// component and reads a log out as soon as it holds --log_watermark records,
+// while the application keeps running. Drained records are appended, as
+// --log_raw blocks, to one of two host buffers. A writer thread decodes a full
+// buffer (or appends it to the raw dump) while the drain thread fills the
+// other one, so the drain thread only waits when it fills a buffer before the
+// writer is done with the previous one.
+//
+// The first word of every record is a per-log sequence number. Records that
+// were overwritten on chip before they could be drained show up as gaps,
+// which are counted per component and reported by log_stream_stop().
+
+#include "header.h"
+
+#include <pthread.h>
+
+#define LOG_STREAM_MAX_SOURCES 16
+#define LOG_STREAM_BUF_BYTES (4 << 20)
+#define LOG_STREAM_MAX_DRAIN 16384   // records per block, one full on-chip log
+#define LOG_STREAM_POLL_US 20
+
+typedef struct {
+    log_source_t src;
+    uint32_t max_xfer;
+    uint32_t next_seq;
+    bool seq_valid;         // next_seq is set by the first valid record; the
+                            // on-chip count only restarts on rstn
+    uint64_t n_records;
+    uint64_t n_blocks;
+    uint64_t n_dropped;
+    uint32_t peak;          // highest DEBUG_CAPACITY seen
+} log_stream_src_t;
+
+static struct {
+    int fd;
+    uint32_t watermark;
+    uint32_t n_src;
+    log_stream_src_t src[LOG_STREAM_MAX_SOURCES];
+    unsigned char* buf[2];
+    size_t len[2];          // bytes of blocks in buf[i]
+    bool full[2];           // buf[i] is owned by the writer
+    int fill;               // buffer the drain thread appends to
+    volatile bool stop;
+    bool done;              // no more buffers will be handed off
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t drain_thread;
+    pthread_t write_thread;
+    bool running;
+    uint64_t n_waits;       // times the drain thread waited for the writer
+} lst;
+
+// Same transfer sizes as the synchronous log_<kind> functions
+static uint32_t log_stream_max_xfer(log_kind_t kind) {
+    switch (kind) {
+        case LOG_CACHE:
+        case LOG_SPLITTER:
+        case LOG_COALESCER:
+        case LOG_CQ:
+        case LOG_DDR:
+        case LOG_AXI:
+            return 512;
+        default:
+            return 3200;
+    }
+}
+
+static uint32_t log_stream_occupancy(log_stream_src_t* s) {
+    uint32_t n;
+    pci_peek(s->src.id >> 8, s->src.id & 0xff, DEBUG_CAPACITY, &n);
+    // Same fix-ups as log_cache and log_cq; anything else this large is not
+    // a valid count.
+    if (n > 17000) {
+        if ((s->src.kind == LOG_CACHE || s->src.kind == LOG_CQ) && n < 34000) {
+            n -= 16384;
+        } else {
+            n = 0;
+        }
+    }
+    return n;
+}
+
+// Hands the buffer being filled to the writer and continues in the other one.
+// If the writer still owns the other one, waits for it when wait is set and
+// keeps filling the current one otherwise.
+static void log_stream_handoff(bool wait) {
+    int other = lst.fill ^ 1;
+    pthread_mutex_lock(&lst.lock);
+    if (lst.full[other]) {
+        if (!wait) {
+            pthread_mutex_unlock(&lst.lock);
+            return;
+        }
+        lst.n_waits++;
+        while (lst.full[other]) pthread_cond_wait(&lst.cond, &lst.lock);
+    }
+    lst.full[lst.fill] = true;
+    lst.fill = other;
+    pthread_cond_broadcast(&lst.cond);
+    pthread_mutex_unlock(&lst.lock);
+}
+
+// Reads n records of s into a new block. Returns the number read.
+static uint32_t log_stream_drain(log_stream_src_t* s, uint32_t n) {
+    if (n > LOG_STREAM_MAX_DRAIN) n = LOG_STREAM_MAX_DRAIN;
+    size_t read_len = n * LOG_RECORD_BYTES;
+    if (lst.len[lst.fill] + sizeof(log_block_hdr_t) + read_len > LOG_STREAM_BUF_BYTES) {
+        log_stream_handoff(true);
+    }
+    unsigned char* block = lst.buf[lst.fill] + lst.len[lst.fill];
+    unsigned char* records = block + sizeof(log_block_hdr_t);
+    log_block_hdr_t hdr;
+    log_block_init(&hdr, s->src.kind, s->src.id, n, 0);
+
+    uint64_t cl_addr = (1L<<36) + ((uint64_t) s->src.id << 20);
+    size_t read_offset = 0;
+    while (read_offset < read_len) {
+        size_t xfer = read_len - read_offset;
+        if (xfer > s->max_xfer) xfer = s->max_xfer;
+        ssize_t rc = pread(lst.fd, records + read_offset, xfer, cl_addr);
+        if (rc <= 0) break;
+        read_offset += rc;
+    }
+    hdr.n_records = read_offset / LOG_RECORD_BYTES;
+    if (hdr.n_records == 0) return 0;
+    memcpy(block, &hdr, sizeof(hdr));
+    lst.len[lst.fill] += sizeof(hdr) + hdr.n_records * LOG_RECORD_BYTES;
+
+    uint32_t* words = (uint32_t*) records;
+    for (uint32_t r=0;r<hdr.n_records;r++) {
+        uint32_t seq = words[r * (LOG_RECORD_BYTES / 4)];
+        if (seq == -1) continue;  // invalid entry
+        if (s->seq_valid && (int32_t) (seq - s->next_seq) > 0) {
+            s->n_dropped += seq - s->next_seq;
+        }
+        s->next_seq = seq + 1;
+        s->seq_valid = true;
+    }
+    s->n_records += hdr.n_records;
+    s->n_blocks++;
+    return hdr.n_records;
+}
+
+static void* log_stream_drain_thread(void* arg) {
+    while (true) {
+        // Sampled before the sweep, so that the last sweep starts after
+        // log_stream_stop() and empties every log.
+        bool stop = lst.stop;
+        bool drained = false;
+        for (uint32_t i=0;i<lst.n_src;i++) {
+            log_stream_src_t* s = &lst.src[i];
+            uint32_t n = log_stream_occupancy(s);
+            if (n > s->peak) s->peak = n;
+            if (stop) {
+                while (n > 0 && log_stream_drain(s, n) > 0) {
+                    n = log_stream_occupancy(s);
+                }
+            } else if (n >= lst.watermark) {
+                log_stream_drain(s, n);
+                drained = true;
+            }
+        }
+        if (stop) break;
+        if (lst.len[lst.fill] > 0) log_stream_handoff(false);
+        if (!drained) usleep(LOG_STREAM_POLL_US);
+    }
+    if (lst.len[lst.fill] > 0) log_stream_handoff(true);
+    pthread_mutex_lock(&lst.lock);
+    lst.done = true;
+    pthread_cond_broadcast(&lst.cond);
+    pthread_mutex_unlock(&lst.lock);
+    return NULL;
+}
+
+static void log_stream_write(const unsigned char* buf, size_t len) {
+    if (log_raw_enabled()) {
+        log_raw_write(buf, len);
+        return;
+    }
+    size_t offset = 0;
+    while (offset < len) {
+        const log_block_hdr_t* hdr = (const log_block_hdr_t*) (buf + offset);
+        unsigned char* records = (unsigned char*) buf + offset + hdr->hdr_bytes;
+        FILE* fw = NULL;
+        for (uint32_t i=0;i<lst.n_src;i++) {
+            if (lst.src[i].src.kind == hdr->kind && lst.src[i].src.id == hdr->id) {
+                fw = lst.src[i].src.fw;
+            }
+        }
+        if (fw != NULL) {
+            write_log_header(hdr->kind, fw, hdr->log_size);
+            write_log(hdr->kind, records, fw, hdr->n_records, hdr->id);
+        }
+        offset += hdr->hdr_bytes + hdr->n_records * LOG_RECORD_BYTES;
+    }
+    for (uint32_t i=0;i<lst.n_src;i++) {
+        if (lst.src[i].src.fw != NULL) fflush(lst.src[i].src.fw);
+    }
+}
+
+// Buffers are handed off alternately, starting with buf[0], and written in
+// the same order.
+static void* log_stream_write_thread(void* arg) {
+    int cur = 0;
+    while (true) {
+        pthread_mutex_lock(&lst.lock);
+        while (!lst.full[cur] && !lst.done) pthread_cond_wait(&lst.cond, &lst.lock);
+        bool full = lst.full[cur];
+        pthread_mutex_unlock(&lst.lock);
+        if (!full) break;
+
+        log_stream_write(lst.buf[cur], lst.len[cur]);
+
+        pthread_mutex_lock(&lst.lock);
+        lst.len[cur] = 0;
+        lst.full[cur] = false;
+        pthread_cond_broadcast(&lst.cond);
+        pthread_mutex_unlock(&lst.lock);
+        cur ^= 1;
+    }
+    return NULL;
+}
+
+// Starts draining the given logs through DMA handle fd. Each source's log
+// must not be read by anyone else until log_stream_stop().
+int log_stream_start(int fd, const log_source_t* sources, uint32_t n_sources,
+        uint32_t watermark) {
+    memset(&lst, 0, sizeof(lst));
+    if (n_sources > LOG_STREAM_MAX_SOURCES) {
+        printf("Too many log sources (max %d)\n", LOG_STREAM_MAX_SOURCES);
+        return 1;
+    }
+    lst.fd = fd;
+    lst.watermark = watermark > 0 ? watermark : 1;
+    lst.n_src = n_sources;
+    for (uint32_t i=0;i<n_sources;i++) {
+        lst.src[i].src = sources[i];
+        lst.src[i].max_xfer = log_stream_max_xfer(sources[i].kind);
+    }
+    for (int b=0;b<2;b++) {
+        lst.buf[b] = (unsigned char*) malloc(LOG_STREAM_BUF_BYTES);
+        if (lst.buf[b] == NULL) {
+            printf("Unable to allocate log stream buffers\n");
+            free(lst.buf[0]);
+            return 1;
+        }
+    }
+    log_no_rollback = NO_ROLLBACK;
+    pthread_mutex_init(&lst.lock, NULL);
+    pthread_cond_init(&lst.cond, NULL);
+    if (pthread_create(&lst.write_thread, NULL, log_stream_write_thread, NULL)) {
+        printf("Unable to start log writer thread\n");
+        return 1;
+    }
+    if (pthread_create(&lst.drain_thread, NULL, log_stream_drain_thread, NULL)) {
+        printf("Unable to start log drain thread\n");
+        pthread_mutex_lock(&lst.lock);
+        lst.done = true;
+        pthread_cond_broadcast(&lst.cond);
+        pthread_mutex_unlock(&lst.lock);
+        pthread_join(lst.write_thread, NULL);
+        return 1;
+    }
+    lst.running = true;
+    printf("Log stream: %d logs, watermark %d records\n", n_sources, lst.watermark);
+    return 0;
+}
+
+// Empties every log one last time, waits for everything to be written and
+// reports how many records were captured and dropped.
+void log_stream_stop() {
+    if (!lst.running) return;
+    lst.stop = true;
+    pthread_join(lst.drain_thread, NULL);
+    pthread_join(lst.write_thread, NULL);
+    lst.running = false;
+
+    uint64_t n_records = 0, n_blocks = 0, n_dropped = 0;
+    for (uint32_t i=0;i<lst.n_src;i++) {
+        log_stream_src_t* s = &lst.src[i];
+        printf("  %-11s %5x: records %9lu blocks %7lu dropped %9lu peak %5d\n",
+                log_kind_names[s->src.kind], s->src.id,
+                s->n_records, s->n_blocks, s->n_dropped, s->peak);
+        n_records += s->n_records;
+        n_blocks += s->n_blocks;
+        n_dropped += s->n_dropped;
+    }
+    printf("Log stream: %lu records in %lu blocks, %lu dropped, "
+            "%lu waits for the writer\n",
+            n_records, n_blocks, n_dropped, lst.n_waits);
+    if (n_dropped > 0) {
+        printf("Log stream: records were lost to log overflow; "
+                "lower --log_watermark\n");
+    }
+    free(lst.buf[0]);
+    free(lst.buf[1]);
+    pthread_mutex_destroy(&lst.lock);
+    pthread_cond_destroy(&lst.cond);
+}
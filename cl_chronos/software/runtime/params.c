@@ -0,0 +1,187 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Task unit, spill and enqueuer parameters.
+//
+// params lists the knobs test_chronos used to hard-code. Each can be set with
+// --<name>=<value>, from a config file (--config=<file>: one name=value per
+// line, '#' starts a comment), or from a tuned configuration database
+// (--tuned=<file>, written by tune.py). Values given on the command line or
+// in a config file take precedence over tuned ones, which take precedence
+// over the per-app defaults test_chronos fills in with param_default().
+//
+// The tuned database has one line per app and input class:
+//   <app> <class> <cycles> name=value ...
+// where the class is that of input_class() and cycles is the run time the
+// configuration achieved when it was tuned.
+
+#include "header.h"
+
+param_t params[N_PARAMS] = {
+    [PARAM_SPILL_THRESHOLD]    = { "spill_threshold",
+        "spill when the task queue holds more tasks than this" },
+    [PARAM_TIED_CAP]           = { "tied_cap",
+        "max tied tasks in the task queue" },
+    [PARAM_CLEAN_THRESHOLD]    = { "clean_threshold",
+        "task queue occupancy below which spilled tasks are refilled" },
+    [PARAM_SPILL_SIZE]         = { "spill_size",
+        "tasks per spill, a multiple of 8" },
+    [PARAM_DEQ_TOLERANCE]      = { "deq_tolerance",
+        "TASK_UNIT_PRE_ENQ_BUF dequeue tolerance" },
+    [PARAM_PRE_ENQ_FIFO_THRESH]= { "pre_enq_fifo_thresh",
+        "TASK_UNIT_PRE_ENQ_BUF fifo threshold" },
+    [PARAM_PRODUCER_THRESHOLD] = { "producer_threshold",
+        "TASK_UNIT_PRODUCER_THRESHOLD (color: 100, others: hardware default)" },
+    [PARAM_COLOR_CHUNK]        = { "color_chunk",
+        "color: vertices per enqueuer task (headers[9])" },
+    [PARAM_GR_INTERVAL_BIAS]   = { "gr_interval_bias",
+        "maxflow: log2 global relabel interval is headers[10] + bias - log2(n_tiles)" },
+    [PARAM_PREFETCH_CAPACITY]  = { "prefetch_capacity",
+        "L2 prefetch fifo entries, up to 32; 0 turns the prefetcher off" },
+};
+
+static int param_lookup(const char* name, size_t len) {
+    for (int i=0;i<N_PARAMS;i++) {
+        if (strlen(params[i].name) == len && strncmp(name, params[i].name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Parses "name=value". Values already set are only overwritten if override.
+static int param_assign(const char* str, bool override) {
+    const char* eq = strchr(str, '=');
+    if (eq == NULL) return -1;
+    int id = param_lookup(str, eq - str);
+    if (id < 0) return -1;
+    char* end;
+    long value = strtol(eq + 1, &end, 0);
+    if (end == eq + 1 || value < 0) {
+        printf("param: bad value in %s\n", str);
+        exit(1);
+    }
+    if (override || !params[id].set) {
+        params[id].value = value;
+        params[id].set = true;
+    }
+    return id;
+}
+
+// Returns 1 if arg is --<name>=<value> for one of params
+int param_parse_option(const char* arg) {
+    if (strncmp(arg, "--", 2) != 0) return 0;
+    return param_assign(arg + 2, true) >= 0;
+}
+
+int param_load_config(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("param: unable to open %s\n", path);
+        return 1;
+    }
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        char* tok = strtok(line, " \t\r\n");
+        if (tok == NULL) continue;
+        if (param_assign(tok, true) < 0) {
+            printf("param: %s:%d: unknown parameter %s\n", path, lineno, tok);
+            fclose(f);
+            return 1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static uint32_t log2_floor(uint32_t x) {
+    uint32_t r = 0;
+    while (x >>= 1) r++;
+    return r;
+}
+
+// Inputs of the same class are expected to share a tuned configuration.
+// headers[1] and headers[2] are the vertex and edge counts of the graph apps,
+// and size the input of the others.
+void input_class(char* buf, size_t len, const uint32_t* headers) {
+    snprintf(buf, len, "v%u_e%u", log2_floor(headers[1]), log2_floor(headers[2]));
+}
+
+// Applies the entry for app and cls, if any, to the params not set yet.
+// Returns 1 if there is no such entry.
+int param_load_tuned(const char* path, const char* app, const char* cls) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("tuned: unable to open %s\n", path);
+        return 1;
+    }
+    char line[1024];
+    int found = 1;
+    while (found && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        char* save;
+        char* l_app = strtok_r(line, " \t\r\n", &save);
+        char* l_cls = strtok_r(NULL, " \t\r\n", &save);
+        char* l_cycles = strtok_r(NULL, " \t\r\n", &save);
+        if (l_cycles == NULL || strcmp(l_app, app) || strcmp(l_cls, cls)) continue;
+        printf("tuned: %s %s from %s (%s cycles when tuned)\n",
+                app, cls, path, l_cycles);
+        for (char* tok = strtok_r(NULL, " \t\r\n", &save); tok != NULL;
+                tok = strtok_r(NULL, " \t\r\n", &save)) {
+            if (param_assign(tok, false) < 0) {
+                printf("tuned: ignoring unknown parameter %s\n", tok);
+            }
+        }
+        found = 0;
+    }
+    fclose(f);
+    if (found) printf("tuned: no entry for %s %s in %s\n", app, cls, path);
+    return found;
+}
+
+void param_default(int id, uint32_t value) {
+    if (!params[id].set) params[id].value = value;
+    params[id].valid = true;
+}
+
+// Whether the param was given or defaulted, i.e. applies to this app
+bool param_valid(int id) {
+    return params[id].set || params[id].valid;
+}
+
+uint32_t param(int id) {
+    return params[id].value;
+}
+
+// One line, in the format of the tuned database, for tune.py to pick up
+void param_print() {
+    printf("params");
+    for (int i=0;i<N_PARAMS;i++) {
+        if (param_valid(i)) printf(" %s=%u", params[i].name, params[i].value);
+    }
+    printf("\n");
+}
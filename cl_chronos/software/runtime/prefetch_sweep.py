@@ -0,0 +1,83 @@
+import sys
+import json
+import os
+import tempfile
+import chronos_run
+
+# Runs test_chronos on one input for a range of L2 prefetch fifo capacities
+# and reports runtime and L2 behaviour for each, to decide whether an app
+# benefits from prefetching. Capacity 0 turns the prefetcher off and is the
+# baseline for the speedups.
+#
+# Usage: python3 prefetch_sweep.py [--bin=./test_chronos] [--caps=0,4,8,16,32]
+#            [--runs=N] [test_chronos options] app input [riscv_hex_file]
+#
+# With --runs=N, every capacity is run N times and the runs are averaged.
+# Runs that test_chronos reports as failed (see chronos_run.py) are left out.
+
+def run(binary, opts, cap, positional, json_path):
+    cmd = [binary] + opts + ['--prefetch_capacity=%d' % cap,
+                             '--stats_json=%s' % json_path] + positional
+    if not chronos_run.run(cmd).ok():
+        return None
+    return json.load(open(json_path))
+
+def main():
+    binary = './test_chronos'
+    caps = [0, 4, 8, 16, 32]
+    n_runs = 1
+    opts = []
+    positional = []
+    for arg in sys.argv[1:]:
+        if arg.startswith('--bin='):
+            binary = arg[6:]
+        elif arg.startswith('--caps='):
+            caps = [int(c) for c in arg[7:].split(',')]
+        elif arg.startswith('--runs='):
+            n_runs = int(arg[7:])
+        elif arg.startswith('--'):
+            opts.append(arg)
+        else:
+            positional.append(arg)
+    if len(positional) < 2:
+        print("Usage: python3 prefetch_sweep.py [--bin=./test_chronos] "
+              "[--caps=0,4,8,16,32] [--runs=N] [options] app input")
+        exit(0)
+
+    (fd, json_path) = tempfile.mkstemp(suffix='.json')
+    os.close(fd)
+    rows = []
+    for cap in caps:
+        stats = []
+        for i in range(n_runs):
+            s = run(binary, opts, cap, positional, json_path)
+            if s is not None:
+                stats.append(s)
+        if len(stats) == 0:
+            print("capacity %d: no run completed" % cap)
+            continue
+        n = float(len(stats))
+        cycles = sum(s['cycles'] for s in stats) / n
+        total = [s['total'] for s in stats]
+        hit_rate = sum(t['derived']['l2_hit_rate'] for t in total) / n
+        fill = sum(t['derived']['l2_prefetch_fill_ratio'] for t in total) / n
+        prefetches = sum(t['counters']['L2_0_PREFETCH_HITS'] +
+                         t['counters']['L2_0_PREFETCH_MISSES'] +
+                         t['counters']['L2_1_PREFETCH_HITS'] +
+                         t['counters']['L2_1_PREFETCH_MISSES'] for t in total) / n
+        rows.append((cap, cycles, hit_rate, prefetches, fill, len(stats)))
+    os.unlink(json_path)
+    if len(rows) == 0:
+        exit(0)
+
+    base = rows[0][1]
+    print("%8s %12s %8s %10s %12s %8s %5s" % ('capacity', 'cycles', 'speedup',
+          'l2 hits', 'prefetches', 'filled', 'runs'))
+    for (cap, cycles, hit_rate, prefetches, fill, n) in rows:
+        print("%8d %12.0f %8.3f %9.2f%% %12.0f %7.2f%% %5d" % (cap, cycles,
+              base / cycles, hit_rate * 100, prefetches, fill * 100, n))
+    best = min(rows, key=lambda r: r[1])
+    print("best: --prefetch_capacity=%d (%.3fx over capacity %d)" %
+          (best[0], base / best[1], rows[0][0]))
+
+main()
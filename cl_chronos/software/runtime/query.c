@@ -0,0 +1,295 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Batched SSSP / A* queries on an uploaded graph (--queries=<file>).
+//
+// The query file has one "source [destination]" pair of vertex IDs per line
+// ('#' starts a comment; the destination is only used by astar). Once the
+// input is in DDR and the tiles are configured, each query:
+//  - reset:    restores the dist array from the host copy of the input (the
+//              only part of it SSSP and A* write), sets the per-query header
+//              registers (source, destination and, for A*, the destination's
+//              lat/lon) through pci_config, and enqueues the start task
+//  - run:      starts the cores and polls for completion
+//  - readback: stops the cores, flushes the L2s and reads back the answer:
+//              the whole dist array for SSSP, the destination's line for A*
+// A completed run leaves the task queues and spill areas empty, so they are
+// not re-initialised between queries.
+//
+// Queries from the input's own source are checked against its ground truth.
+// Per-query results and times go to stdout and, with --query_out=<file>, to a
+// tab-separated table:
+//   query src dst result cycles reset_us run_us readback_us total_us errors
+// where result is the destination's distance for A*, and the number of
+// reached vertices for SSSP.
+
+#include "header.h"
+
+#define QUERY_TIMEOUT_US 30000000
+
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+} query_t;
+
+static int query_cmp(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t query_cycle() {
+    uint32_t msb, lsb, msb2;
+    do {
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb);
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb2);
+    } while (msb != msb2);
+    return ((uint64_t) msb << 32) | lsb;
+}
+
+// Same termination test as the main run loop of test_chronos
+static bool query_done(uint32_t n_tiles) {
+    uint32_t gvt;
+    if (!NO_ROLLBACK) {
+        pci_peek(0, ID_CQ, CQ_GVT_TS, &gvt);
+        return gvt == -1;
+    }
+    pci_peek(0, ID_OCL_SLAVE, OCL_DONE, &gvt);
+    if (gvt != -1) return false;
+    // the pseudo-gvt is not non-decreasing; sample a few times
+    for (int i=0;i<64;i++) {
+        usleep(1);
+        pci_peek(i % n_tiles, ID_OCL_SLAVE, OCL_DONE, &gvt);
+        if (gvt != -1) return false;
+    }
+    return true;
+}
+
+static query_t* query_load(const char* path, uint32_t* n_queries) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("Unable to open query file %s\n", path);
+        return NULL;
+    }
+    uint32_t n = 0, cap = 64;
+    query_t* q = (query_t*) malloc(cap * sizeof(query_t));
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        uint32_t src, dst;
+        int k = sscanf(line, "%u %u", &src, &dst);
+        if (k < 1) continue;
+        if (n == cap) {
+            cap *= 2;
+            q = (query_t*) realloc(q, cap * sizeof(query_t));
+        }
+        q[n].src = src;
+        q[n].dst = (k == 2) ? dst : src;
+        n++;
+    }
+    fclose(fp);
+    *n_queries = n;
+    return q;
+}
+
+int run_queries(const char* path, const char* out_path, int app,
+        const chronos_input_t* in, uint32_t n_tiles, uint32_t core_mask) {
+    if (app != APP_SSSP && app != APP_ASTAR) {
+        printf("--queries: only sssp and astar\n");
+        return 1;
+    }
+    uint32_t n_queries;
+    query_t* queries = query_load(path, &n_queries);
+    if (queries == NULL) return 1;
+    const uint32_t* headers = in->headers;
+    const uint32_t* words = (const uint32_t*) in->data;
+    uint32_t numV = headers[1];
+    size_t dist_addr = headers[5] * 4ul;
+    size_t dist_len = numV * 4ul;
+    uint32_t input_src = headers[7];
+    uint32_t ref_loc = (app == APP_ASTAR) ? headers[9] : headers[6];
+    for (uint32_t i=0;i<n_queries;i++) {
+        if (queries[i].src >= numV || queries[i].dst >= numV) {
+            printf("Query %d: vertex out of range (%d vertices)\n", i, numV);
+            free(queries);
+            return 1;
+        }
+    }
+    FILE* fw = NULL;
+    if (out_path != NULL) {
+        fw = fopen(out_path, "w");
+        if (fw == NULL) {
+            printf("Unable to open %s\n", out_path);
+            free(queries);
+            return 1;
+        }
+        fprintf(fw, "query\tsrc\tdst\tresult\tcycles\treset_us\trun_us\t"
+                "readback_us\ttotal_us\terrors\n");
+    }
+    uint32_t* dist = NULL;
+    if (app == APP_SSSP && posix_memalign((void**) &dist, 4096, dist_len + 64)) {
+        printf("Unable to allocate %lu bytes for results\n", dist_len);
+        if (fw != NULL) fclose(fw);
+        free(queries);
+        return 1;
+    }
+    uint64_t* total_ns = (uint64_t*) malloc(n_queries * sizeof(uint64_t));
+    uint64_t sum_reset = 0, sum_run = 0, sum_readback = 0, sum_cycles = 0;
+    uint32_t n_done = 0, n_checked = 0, n_failed = 0;
+    int rc = 0;
+
+    stage_begin("queries");
+    uint64_t t_start = timer_ns();
+    for (uint32_t q=0;q<n_queries;q++) {
+        uint32_t src = queries[q].src;
+        uint32_t dst = queries[q].dst;
+        uint64_t t0 = timer_ns();
+        if (dma_write(in->data + dist_addr, dist_len, dist_addr)) {
+            printf("Query %d: unable to reset dist\n", q);
+            rc = 1;
+            break;
+        }
+        pci_batch_begin();
+        for (uint32_t i=0;i<N_TILES;i++) {
+            pci_config(i, ID_ALL_APP_CORES, 7*4, src);
+            pci_config(i, ID_ALL_APP_CORES, 8*4, dst);
+            if (app == APP_ASTAR) {
+                uint32_t dest_lat_addr = headers[6] + dst * 2;
+                pci_config(i, ID_ALL_APP_CORES, 11*4, words[dest_lat_addr]);
+                pci_config(i, ID_ALL_APP_CORES, 12*4, words[dest_lat_addr + 1]);
+            }
+            pci_poke(i, ID_ALL_APP_CORES, CORE_N_DEQUEUES, 0xfffffff);
+        }
+        if (app == APP_ASTAR) {
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARG_WORD, 0 );
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARGS , 0 );
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARG_WORD, 1 );
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARGS , 0xffffffff );
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, 1 );
+        } else {
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARG_WORD, 0 );
+            pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, 0 );
+        }
+        pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_OBJECT , src );
+        pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ, 0 );
+        if (pci_batch_end()) {
+            rc = 1;
+            break;
+        }
+
+        uint64_t t1 = timer_ns();
+        uint64_t start_cycle = query_cycle();
+        for (uint32_t i=0;i<N_TILES;i++) {
+            pci_poke(i, ID_TASK_UNIT, TASK_UNIT_START, 1);
+            pci_poke(i, ID_ALL_CORES, CORE_START, core_mask);
+        }
+        bool done;
+        while (!(done = query_done(n_tiles))) {
+            if (timer_ns() - t1 > QUERY_TIMEOUT_US * 1000ull) break;
+            usleep(10);
+        }
+        uint64_t cycles = query_cycle() - start_cycle;
+        uint64_t t2 = timer_ns();
+
+        pci_poke(0, ID_ALL_APP_CORES, CORE_N_DEQUEUES, 0);
+        for (uint32_t i=0;i<N_TILES;i++) {
+            pci_poke(i, ID_ALL_CORES, CORE_START, 0);
+        }
+        if (!done) {
+            printf("Query %d (%d -> %d) did not complete\n", q, src, dst);
+            rc = 1;
+            break;
+        }
+        stat_wait_quiet(n_tiles, 300000);
+        l2_flush(N_TILES, 1000000);
+        uint32_t result = 0;
+        uint32_t errors = 0;
+        bool check = (src == input_src);
+        if (app == APP_SSSP) {
+            if (dma_read((unsigned char*) dist, dist_len, dist_addr)) {
+                printf("Query %d: result readback failed\n", q);
+                rc = 1;
+                continue;
+            }
+            for (uint32_t v=0;v<numV;v++) {
+                result += (dist[v] != -1);
+                if (check) errors += (dist[v] != words[ref_loc + v]);
+            }
+        } else {
+            uint32_t line[16];
+            size_t addr = (dist_addr + dst * 4ul) & ~63ul;
+            if (dma_read((unsigned char*) line, 64, addr)) {
+                printf("Query %d: result readback failed\n", q);
+                rc = 1;
+                continue;
+            }
+            result = line[(dist_addr + dst * 4ul - addr) / 4];
+            uint32_t ref = words[ref_loc + dst];
+            if (check && ref != -1) errors = abs((int) (result - ref)) > 5;
+        }
+        uint64_t t3 = timer_ns();
+
+        n_checked += check;
+        n_failed += (errors > 0);
+        sum_reset += t1 - t0;
+        sum_run += t2 - t1;
+        sum_readback += t3 - t2;
+        sum_cycles += cycles;
+        total_ns[n_done++] = t3 - t0;
+        printf("query %d: %d -> %d result %u cycles %lu time %.1f us%s\n", q,
+                src, dst, result, cycles, (t3 - t0) / 1e3,
+                check ? (errors ? " FAIL" : " MATCH") : "");
+        if (fw != NULL) {
+            fprintf(fw, "%u\t%u\t%u\t%u\t%lu\t%.1f\t%.1f\t%.1f\t%.1f\t%s\n",
+                    q, src, dst, result, cycles, (t1 - t0) / 1e3,
+                    (t2 - t1) / 1e3, (t3 - t2) / 1e3, (t3 - t0) / 1e3,
+                    check ? (errors ? "1" : "0") : "-");
+        }
+    }
+    uint64_t wall = timer_ns() - t_start;
+    stage_end();
+
+    uint32_t n = n_done;
+    if (n > 0) {
+        qsort(total_ns, n, sizeof(uint64_t), query_cmp);
+        printf("Queries: %d in %.3f ms, %.1f queries/s\n", n, wall / 1e6,
+                n / (wall / 1e9));
+        printf("\tlatency p50 %.1f us p99 %.1f us max %.1f us\n",
+                total_ns[n / 2] / 1e3, total_ns[(uint64_t) n * 99 / 100] / 1e3,
+                total_ns[n - 1] / 1e3);
+        printf("\tmean reset %.1f us run %.1f us (%.0f cycles) readback %.1f us\n",
+                sum_reset / 1e3 / n, sum_run / 1e3 / n, (double) sum_cycles / n,
+                sum_readback / 1e3 / n);
+        if (n_checked > 0) {
+            printf("\t%d queries from the input's source, %d failed\n",
+                    n_checked, n_failed);
+        }
+    }
+    if (fw != NULL) fclose(fw);
+    free(dist);
+    free(total_ns);
+    free(queries);
+    if (n_failed > 0) rc = 1;
+    return rc;
+}
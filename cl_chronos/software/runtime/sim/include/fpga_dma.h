@@ -0,0 +1,45 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Subset of the aws-fpga SDK fpga_dma.h used by the runtime.
+
+#ifndef SIM_FPGA_DMA_H
+#define SIM_FPGA_DMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+enum fpga_dma_driver {
+    FPGA_DMA_EDMA,
+    FPGA_DMA_XDMA,
+};
+
+int fpga_dma_open_queue(enum fpga_dma_driver which_driver, int slot_id,
+        int channel, bool is_read);
+int fpga_dma_burst_write(int fd, uint8_t *buffer, size_t xfer_sz,
+        size_t address);
+int fpga_dma_burst_read(int fd, uint8_t *buffer, size_t xfer_sz,
+        size_t address);
+
+#endif
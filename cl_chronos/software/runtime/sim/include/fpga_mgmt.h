@@ -0,0 +1,61 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Subset of the aws-fpga SDK fpga_mgmt.h used by the runtime.
+
+#ifndef SIM_FPGA_MGMT_H
+#define SIM_FPGA_MGMT_H
+
+#include <stdint.h>
+#include "fpga_pci.h"
+
+#define FPGA_STATUS_LOADED 0
+#define FPGA_PF_MAX 2
+
+struct fpga_pci_resource_map {
+    uint16_t vendor_id;
+    uint16_t device_id;
+};
+
+struct fpga_slot_spec {
+    struct fpga_pci_resource_map map[FPGA_PF_MAX];
+};
+
+#define AFI_ID_STR_MAX 64
+
+struct fpga_meta_ids {
+    char afi_id[AFI_ID_STR_MAX];
+};
+
+struct fpga_mgmt_image_info {
+    int status;
+    struct fpga_meta_ids ids;
+    struct fpga_slot_spec spec;
+    uint32_t sh_version;
+};
+
+int fpga_mgmt_init(void);
+int fpga_mgmt_describe_local_image(int slot_id,
+        struct fpga_mgmt_image_info *info, uint32_t flags);
+
+#endif
@@ -0,0 +1,59 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Subset of the aws-fpga SDK fpga_pci.h used by the runtime. Only used when
+// building against the software FPGA model (make sim); see sim/sim_fpga.c.
+
+#ifndef SIM_FPGA_PCI_H
+#define SIM_FPGA_PCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int pci_bar_handle_t;
+#define PCI_BAR_HANDLE_INIT (-1)
+
+#define FPGA_APP_PF   0
+#define FPGA_MGMT_PF  1
+#define APP_PF_BAR0   0
+#define APP_PF_BAR4   4
+
+int fpga_pci_init(void);
+int fpga_pci_attach(int slot_id, int pf_id, int bar_id, uint32_t flags,
+        pci_bar_handle_t *handle);
+int fpga_pci_detach(pci_bar_handle_t handle);
+int fpga_pci_peek(pci_bar_handle_t handle, uint64_t offset, uint32_t *value);
+int fpga_pci_poke(pci_bar_handle_t handle, uint64_t offset, uint32_t value);
+int fpga_pci_rescan_slot_app_pfs(int slot_id);
+int fpga_pci_get_address(pci_bar_handle_t handle, uint64_t offset,
+        size_t dword_len, void **ptr);
+
+// Not in the SDK. Registers of the model are computed on access, so loads and
+// stores to the addresses fpga_pci_get_address returns go through these; see
+// OCL_MMIO_READ/WRITE in header.h.
+uint32_t sim_mmio_read(const volatile uint32_t* p);
+void sim_mmio_write(volatile uint32_t* p, uint32_t value);
+#define OCL_MMIO_READ(p) sim_mmio_read(p)
+#define OCL_MMIO_WRITE(p, v) sim_mmio_write(p, v)
+
+#endif
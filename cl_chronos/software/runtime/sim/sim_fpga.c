@@ -0,0 +1,597 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Software model of an F1 slot running Chronos. Linked in place of the
+// aws-fpga SDK (libfpga_mgmt) by 'make sim', so that the host-side stages of
+// test_chronos (input load, spill init, OCL configuration, polling, readback)
+// can be run and profiled without an FPGA.
+//
+// OCL: a flat register file indexed by the 24-bit OCL address
+//   {tile, component, register} (see addr_map.vh). Writes are stored and read
+//   back, except for a few registers that are modelled:
+//      - OCL_PARAM_*          : build parameters, set through the environment
+//      - OCL_CUR_CYCLE_*      : wall clock scaled to CHRONOS_SIM_CLOCK_MHZ
+//      - CQ_GVT_TS / OCL_DONE : read -1 once CHRONOS_SIM_RUN_US has elapsed
+//                               since the first CORE_START
+//      - L2_FLUSH             : reads 1 for CHRONOS_SIM_FLUSH_US after a flush
+//      - TASK_UNIT_N_TASKS    : a quarter of the task queue while the run
+//                               lasts
+//      - DEBUG_CAPACITY       : records in the component's debug log, see
+//                               CHRONOS_SIM_LOG_RATE
+//      - task unit / CQ / L2 counters advance with the cycles of the run.
+//   The register file is a shared mapping, so that like the FPGA's it outlives
+//   the job processes of test_chronos daemon.
+//   fpga_pci_get_address returns addresses in an inaccessible window; the
+//   runtime's OCL_MMIO_READ/WRITE accessors for BAR0 (see sim/include/
+//   fpga_pci.h) turn them back into register accesses of the same model.
+// DDR: a sparse memfd covering the 64 GB DDR space and the debug log window
+//   at 1<<36. The fds returned by fpga_dma_open_queue are dups of it, so the
+//   runtime's direct pread/pwrite calls work unmodified. pread/pwrite are
+//   wrapped at link time (-Wl,--wrap) to apply the DMA cost model; close is
+//   wrapped to retire the fd's channel.
+// Debug logs: with CHRONOS_SIM_LOG_RATE > 0, every component logs records at
+//   that rate while the run lasts, into a log of CHRONOS_SIM_LOG_DEPTH
+//   records; older records are dropped when it is full. Reads from the log
+//   window pop records: {seq, cycle, 14 pseudo-random words}, where seq counts
+//   all records ever logged, so drops show up as gaps.
+//
+// Environment knobs (all optional):
+//   CHRONOS_SIM_N_TILES, _N_CORES, _LOG_TQ_SIZE, _TQ_STAGES, _LOG_CQ_SIZE,
+//   _LOG_SPILL_Q_SIZE, _NO_ROLLBACK, _APP_ID, _LOG_READY_LIST_SIZE,
+//   _LOG_L2_BANKS                  build parameters reported over OCL
+//   CHRONOS_SIM_CLOCK_MHZ          FPGA clock (default 125)
+//   CHRONOS_SIM_RUN_US             modelled application runtime (default 1000)
+//   CHRONOS_SIM_FLUSH_US           modelled L2 flush time (default 0)
+//   CHRONOS_SIM_PEEK_NS            OCL read round trip (default 0)
+//   CHRONOS_SIM_POKE_NS            OCL (posted) write cost (default 0)
+//   CHRONOS_SIM_LIB_NS             software cost of an fpga_pci_peek/poke
+//                                  call on top of the above; accesses through
+//                                  the mapped BAR do not pay it (default 0)
+//   CHRONOS_SIM_DMA_LATENCY_NS     fixed cost per DMA call (default 0)
+//   CHRONOS_SIM_DMA_MBPS           per-channel DMA bandwidth, 0 = unlimited
+//   CHRONOS_SIM_DMA_MAX_XFER       max bytes moved per pread/pwrite call;
+//                                  larger calls return short (default 0 = off)
+//   CHRONOS_SIM_FAULT_PPM          probability (per million) that an OCL
+//                                  access or a DMA call fails
+//   CHRONOS_SIM_LOG_RATE           debug log records per 1024 cycles per
+//                                  component (default 0 = logs stay empty)
+//   CHRONOS_SIM_LOG_DEPTH          debug log capacity (default 16384)
+//   CHRONOS_SIM_ORACLE             'sssp' or 'astar': on completion, copy the
+//                                  input's ground truth into the result array
+//                                  so that verification passes
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#include <fpga_pci.h>
+#include <fpga_mgmt.h>
+#include <fpga_dma.h>
+
+#include "../header.h"
+
+// Component IDs, as in addr_map.vh
+#define SIM_ID_OCL_SLAVE   0
+#define SIM_ID_TASK_UNIT   6
+#define SIM_ID_L2_RW       7
+#define SIM_ID_L2_RO       8
+#define SIM_ID_CQ         10
+
+#define SIM_OCL_SPACE      (1 << 24)
+#define SIM_DDR_SIZE       (1L << 37) // 64 GB DDR + debug log window
+#define SIM_MAX_FDS        4096
+#define SIM_LOG_WINDOW     (1L << 36)
+#define SIM_MAX_LOG_IDS    (1 << 16)   // {tile, component}
+
+struct sim_config {
+    uint32_t n_tiles;
+    uint32_t n_cores;
+    uint32_t log_tq_size;
+    uint32_t tq_stages;
+    uint32_t log_cq_size;
+    uint32_t log_spill_q_size;
+    uint32_t no_rollback;
+    uint32_t app_id;
+    uint32_t log_ready_list_size;
+    uint32_t log_l2_banks;
+
+    double clock_mhz;
+    uint64_t run_ns;
+    uint64_t flush_ns;
+    uint64_t peek_ns;
+    uint64_t poke_ns;
+    uint64_t lib_ns;
+    uint64_t dma_latency_ns;
+    double dma_mbps;
+    size_t dma_max_xfer;
+    uint32_t fault_ppm;
+    uint32_t log_rate;
+    uint64_t log_depth;
+    char oracle[16];
+};
+
+static struct sim_config cfg;
+static uint32_t* regs;
+static char* mmio_window;      // what fpga_pci_get_address hands out
+static int ddr_fd = -1;
+static bool initialized = false;
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t epoch_ns;
+static uint64_t run_start_ns;  // 0 if no run has been started
+static bool oracle_done;
+static uint64_t flush_done_ns[256][2];
+static uint64_t* log_popped;   // per log ID: records read or dropped so far
+
+// per-fd DMA channel; -1 if the fd is not a sim DMA queue
+static int8_t fd_channel[SIM_MAX_FDS];
+
+// Statistics, printed at exit
+static uint64_t n_peeks, n_pokes, n_mmio_reads, n_mmio_writes;
+static uint64_t n_dma_calls, n_dma_bytes, n_faults;
+
+ssize_t __real_pwrite(int fd, const void* buf, size_t count, off_t offset);
+ssize_t __real_pread(int fd, void* buf, size_t count, off_t offset);
+int __real_close(int fd);
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void spin_ns(uint64_t ns) {
+    if (ns == 0) return;
+    uint64_t end = now_ns() + ns;
+    while (now_ns() < end);
+}
+
+static uint64_t env_u64(const char* name, uint64_t def) {
+    const char* v = getenv(name);
+    if (v == NULL || *v == 0) return def;
+    return strtoull(v, NULL, 0);
+}
+
+static bool inject_fault() {
+    if (cfg.fault_ppm == 0) return false;
+    if ((uint32_t) (random() % 1000000) >= cfg.fault_ppm) return false;
+    __atomic_add_fetch(&n_faults, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void sim_report() {
+    fprintf(stderr, "[sim] peeks:%lu pokes:%lu mmio_reads:%lu mmio_writes:%lu "
+            "dma_calls:%lu dma_bytes:%lu faults:%lu\n", n_peeks, n_pokes,
+            n_mmio_reads, n_mmio_writes, n_dma_calls, n_dma_bytes, n_faults);
+}
+
+static void sim_init() {
+    if (initialized) return;
+    pthread_mutex_lock(&sim_lock);
+    if (!initialized) {
+        cfg.n_tiles          = env_u64("CHRONOS_SIM_N_TILES", 1);
+        cfg.n_cores          = env_u64("CHRONOS_SIM_N_CORES", 8);
+        cfg.log_tq_size      = env_u64("CHRONOS_SIM_LOG_TQ_SIZE", 12);
+        cfg.tq_stages        = env_u64("CHRONOS_SIM_TQ_STAGES", 13);
+        cfg.log_cq_size      = env_u64("CHRONOS_SIM_LOG_CQ_SIZE", 6);
+        cfg.log_spill_q_size = env_u64("CHRONOS_SIM_LOG_SPILL_Q_SIZE", 9);
+        cfg.no_rollback      = env_u64("CHRONOS_SIM_NO_ROLLBACK", 0);
+        cfg.app_id           = env_u64("CHRONOS_SIM_APP_ID", 0);
+        cfg.log_ready_list_size = env_u64("CHRONOS_SIM_LOG_READY_LIST_SIZE", 3);
+        cfg.log_l2_banks     = env_u64("CHRONOS_SIM_LOG_L2_BANKS", 1);
+        cfg.clock_mhz        = env_u64("CHRONOS_SIM_CLOCK_MHZ", 125);
+        cfg.run_ns           = env_u64("CHRONOS_SIM_RUN_US", 1000) * 1000;
+        cfg.flush_ns         = env_u64("CHRONOS_SIM_FLUSH_US", 0) * 1000;
+        cfg.peek_ns          = env_u64("CHRONOS_SIM_PEEK_NS", 0);
+        cfg.poke_ns          = env_u64("CHRONOS_SIM_POKE_NS", 0);
+        cfg.lib_ns           = env_u64("CHRONOS_SIM_LIB_NS", 0);
+        cfg.dma_latency_ns   = env_u64("CHRONOS_SIM_DMA_LATENCY_NS", 0);
+        cfg.dma_mbps         = env_u64("CHRONOS_SIM_DMA_MBPS", 0);
+        cfg.dma_max_xfer     = env_u64("CHRONOS_SIM_DMA_MAX_XFER", 0);
+        cfg.fault_ppm        = env_u64("CHRONOS_SIM_FAULT_PPM", 0);
+        cfg.log_rate         = env_u64("CHRONOS_SIM_LOG_RATE", 0);
+        cfg.log_depth        = env_u64("CHRONOS_SIM_LOG_DEPTH", 16384);
+        const char* oracle = getenv("CHRONOS_SIM_ORACLE");
+        if (oracle) strncpy(cfg.oracle, oracle, sizeof(cfg.oracle)-1);
+
+        regs = (uint32_t*) mmap(NULL, SIM_OCL_SPACE * sizeof(uint32_t),
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE,
+                -1, 0);
+        if (regs == MAP_FAILED) {
+            perror("[sim] unable to allocate register file");
+            exit(1);
+        }
+        // Reserved only, so that plain loads and stores through it fault
+        mmio_window = (char*) mmap(NULL, SIM_OCL_SPACE, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mmio_window == MAP_FAILED) {
+            perror("[sim] unable to reserve the BAR0 window");
+            exit(1);
+        }
+        ddr_fd = memfd_create("chronos_sim_ddr", 0);
+        if (ddr_fd < 0 || ftruncate(ddr_fd, SIM_DDR_SIZE) != 0) {
+            perror("[sim] unable to allocate DDR image");
+            exit(1);
+        }
+        memset(fd_channel, -1, sizeof(fd_channel));
+        log_popped = (uint64_t*) calloc(SIM_MAX_LOG_IDS, sizeof(uint64_t));
+        epoch_ns = now_ns();
+        srandom(1);
+        atexit(sim_report);
+        printf("[sim] software FPGA model: %d tiles, %d cores, %.0f MHz\n",
+                cfg.n_tiles, cfg.n_cores, cfg.clock_mhz);
+        __atomic_store_n(&initialized, true, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static uint64_t cur_cycle() {
+    return (uint64_t) ((now_ns() - epoch_ns) * cfg.clock_mhz / 1000);
+}
+
+// Cycles elapsed in the current (or last) run, saturating at its end.
+static uint64_t run_cycles() {
+    if (run_start_ns == 0) return 0;
+    uint64_t elapsed = now_ns() - run_start_ns;
+    if (elapsed > cfg.run_ns) elapsed = cfg.run_ns;
+    return (uint64_t) (elapsed * cfg.clock_mhz / 1000);
+}
+
+static void run_oracle() {
+    uint32_t headers[16];
+    if (__real_pread(ddr_fd, headers, sizeof(headers), 0) != sizeof(headers)) return;
+    uint32_t ref_loc;
+    if (strcmp(cfg.oracle, "sssp") == 0) ref_loc = headers[6];
+    else if (strcmp(cfg.oracle, "astar") == 0) ref_loc = headers[9];
+    else return;
+    size_t len = (size_t) headers[1] * 4;
+    unsigned char* buf = (unsigned char*) malloc(len);
+    if (__real_pread(ddr_fd, buf, len, (off_t) ref_loc * 4) == len) {
+        __real_pwrite(ddr_fd, buf, len, (off_t) headers[5] * 4);
+    }
+    free(buf);
+}
+
+static bool run_done() {
+    if (run_start_ns == 0) return false;
+    if (now_ns() - run_start_ns < cfg.run_ns) return false;
+    if (!oracle_done) {
+        pthread_mutex_lock(&sim_lock);
+        if (!oracle_done) run_oracle();
+        oracle_done = true;
+        pthread_mutex_unlock(&sim_lock);
+    }
+    return true;
+}
+
+// Records waiting in debug log id; drops the oldest beyond log_depth.
+// Called with sim_lock held.
+static uint64_t log_occupancy(uint32_t id) {
+    if (cfg.log_rate == 0) return 0;
+    uint64_t logged = (run_cycles() * cfg.log_rate) >> 10;
+    if (logged - log_popped[id] > cfg.log_depth) {
+        log_popped[id] = logged - cfg.log_depth;
+    }
+    return logged - log_popped[id];
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// pread from the debug log window: pops up to count/64 records.
+static ssize_t log_read(uint32_t id, void* buf, size_t count) {
+    uint32_t* words = (uint32_t*) buf;
+    pthread_mutex_lock(&sim_lock);
+    uint64_t n = log_occupancy(id);
+    if (n > count / 64) n = count / 64;
+    for (uint64_t r = 0; r < n; r++) {
+        uint64_t seq = log_popped[id] + r;
+        uint32_t* rec = &words[r * 16];
+        rec[0] = (uint32_t) seq;
+        rec[1] = (uint32_t) ((seq << 10) / cfg.log_rate);
+        for (int w = 2; w < 16; w++) {
+            rec[w] = (uint32_t) mix64(((uint64_t) id << 48) ^ (seq << 4) ^ w);
+        }
+    }
+    log_popped[id] += n;
+    pthread_mutex_unlock(&sim_lock);
+    return n * 64;
+}
+
+// Counters that advance with the run, in events per 1024 cycles per tile.
+static uint32_t counter_rate(uint32_t comp, uint32_t reg) {
+    if (comp == SIM_ID_TASK_UNIT) {
+        switch (reg) {
+            case TASK_UNIT_STAT_N_UNTIED_ENQ:   return 96;
+            case TASK_UNIT_STAT_N_DEQ_TASK:     return 128;
+            case TASK_UNIT_STAT_N_COMMIT_UNTIED:return 112;
+            case TASK_UNIT_STAT_N_ABORT_TASK:   return 16;
+            case TASK_UNIT_STAT_N_CYCLES_DEQ_VALID: return 900;
+        }
+    } else if (comp == SIM_ID_CQ) {
+        switch (reg) {
+            case CQ_STAT_N_RESOURCE_ABORTS:     return 4;
+            case CQ_STAT_N_GVT_ABORTS:          return 12;
+            case CQ_N_TASK_NO_CONFLICT:         return 100;
+            case CQ_N_TASK_REAL_CONFLICT:       return 12;
+        }
+    } else if (comp == SIM_ID_L2_RW || comp == SIM_ID_L2_RO) {
+        switch (reg) {
+            case L2_READ_HITS:    return 300;
+            case L2_READ_MISSES:  return 60;
+            case L2_WRITE_HITS:   return 100;
+            case L2_WRITE_MISSES: return 20;
+            case L2_EVICTIONS:    return 30;
+        }
+    }
+    return 0;
+}
+
+static uint32_t sim_read(uint32_t addr) {
+    uint32_t tile = (addr >> 16) & 0xff;
+    uint32_t comp = (addr >> 8) & 0xff;
+    uint32_t reg = addr & 0xff;
+
+    if (comp == SIM_ID_OCL_SLAVE) {
+        switch (reg) {
+            case OCL_PARAM_N_TILES:             return cfg.n_tiles;
+            case OCL_PARAM_N_CORES:             return cfg.n_cores;
+            case OCL_PARAM_LOG_TQ_HEAP_STAGES:  return cfg.tq_stages;
+            case OCL_PARAM_LOG_TQ_SIZE:         return cfg.log_tq_size;
+            case OCL_PARAM_LOG_CQ_SIZE:         return cfg.log_cq_size;
+            case OCL_PARAM_APP_ID:              return cfg.app_id;
+            case OCL_PARAM_LOG_SPILL_Q_SIZE:    return cfg.log_spill_q_size;
+            case OCL_PARAM_NO_ROLLBACK:         return cfg.no_rollback;
+            case OCL_PARAM_LOG_READY_LIST_SIZE: return cfg.log_ready_list_size;
+            case OCL_PARAM_LOG_L2_BANKS:        return cfg.log_l2_banks;
+            case OCL_CUR_CYCLE_LSB:             return cur_cycle() & 0xffffffff;
+            case OCL_CUR_CYCLE_MSB:             return cur_cycle() >> 32;
+            case OCL_DONE:                      return run_done() ? -1 : 0;
+        }
+    }
+    if (reg == DEBUG_CAPACITY) {
+        pthread_mutex_lock(&sim_lock);
+        uint64_t n = log_occupancy((tile << 8) | comp);
+        pthread_mutex_unlock(&sim_lock);
+        return n;
+    }
+    if (comp == SIM_ID_CQ && reg == CQ_GVT_TS) {
+        return run_done() ? -1 : (uint32_t) (run_cycles() >> 4);
+    }
+    if (comp == SIM_ID_TASK_UNIT && reg == TASK_UNIT_N_TASKS) {
+        bool running = run_start_ns != 0 && !run_done();
+        return running ? (1u << cfg.log_tq_size) / 4 : regs[addr];
+    }
+    if ((comp == SIM_ID_L2_RW || comp == SIM_ID_L2_RO) && reg == L2_FLUSH) {
+        return now_ns() < flush_done_ns[tile][comp - SIM_ID_L2_RW] ? 1 : 0;
+    }
+    uint32_t rate = counter_rate(comp, reg);
+    if (rate > 0 && tile < cfg.n_tiles) {
+        return regs[addr] + (uint32_t) ((run_cycles() * rate) >> 10);
+    }
+    return regs[addr];
+}
+
+static void sim_write(uint32_t addr, uint32_t data) {
+    uint32_t tile = (addr >> 16) & 0xff;
+    uint32_t comp = (addr >> 8) & 0xff;
+    uint32_t reg = addr & 0xff;
+
+    if (comp == ID_ALL_CORES && reg == CORE_START) {
+        pthread_mutex_lock(&sim_lock);
+        if (data != 0 && (run_start_ns == 0 || regs[addr] == 0)) {
+            bool any_running = false;
+            for (uint32_t t = 0; t < cfg.n_tiles; t++) {
+                if (regs[(t << 16) | (ID_ALL_CORES << 8) | CORE_START] != 0) {
+                    any_running = true;
+                }
+            }
+            if (!any_running) {
+                run_start_ns = now_ns();
+                oracle_done = false;
+            }
+        }
+        pthread_mutex_unlock(&sim_lock);
+    }
+    if ((comp == SIM_ID_L2_RW || comp == SIM_ID_L2_RO) && reg == L2_FLUSH && data) {
+        flush_done_ns[tile][comp - SIM_ID_L2_RW] = now_ns() + cfg.flush_ns;
+        return;
+    }
+    regs[addr] = data;
+}
+
+int fpga_mgmt_init(void) {
+    sim_init();
+    return 0;
+}
+
+int fpga_pci_init(void) {
+    sim_init();
+    return 0;
+}
+
+int fpga_mgmt_describe_local_image(int slot_id,
+        struct fpga_mgmt_image_info *info, uint32_t flags) {
+    sim_init();
+    memset(info, 0, sizeof(*info));
+    info->status = FPGA_STATUS_LOADED;
+    strcpy(info->ids.afi_id, "sim");
+    info->spec.map[FPGA_APP_PF].vendor_id = pci_vendor_id;
+    info->spec.map[FPGA_APP_PF].device_id = pci_device_id;
+    return 0;
+}
+
+int fpga_pci_rescan_slot_app_pfs(int slot_id) {
+    return 0;
+}
+
+int fpga_pci_attach(int slot_id, int pf_id, int bar_id, uint32_t flags,
+        pci_bar_handle_t *handle) {
+    sim_init();
+    *handle = 0;
+    return 0;
+}
+
+int fpga_pci_detach(pci_bar_handle_t handle) {
+    return 0;
+}
+
+int fpga_pci_peek(pci_bar_handle_t handle, uint64_t offset, uint32_t *value) {
+    sim_init();
+    __atomic_add_fetch(&n_peeks, 1, __ATOMIC_RELAXED);
+    spin_ns(cfg.lib_ns + cfg.peek_ns);
+    if (inject_fault()) {
+        *value = -1;
+        return -EIO;
+    }
+    *value = sim_read(offset & (SIM_OCL_SPACE - 1));
+    return 0;
+}
+
+int fpga_pci_poke(pci_bar_handle_t handle, uint64_t offset, uint32_t value) {
+    sim_init();
+    __atomic_add_fetch(&n_pokes, 1, __ATOMIC_RELAXED);
+    spin_ns(cfg.lib_ns + cfg.poke_ns);
+    if (inject_fault()) return -EIO;
+    sim_write(offset & (SIM_OCL_SPACE - 1), value);
+    return 0;
+}
+
+int fpga_pci_get_address(pci_bar_handle_t handle, uint64_t offset,
+        size_t dword_len, void** ptr) {
+    sim_init();
+    if (offset + dword_len * 4 > SIM_OCL_SPACE) return -EINVAL;
+    *ptr = mmio_window + offset;
+    return 0;
+}
+
+// A failed read of a mapped BAR returns all ones; a failed write is lost.
+uint32_t sim_mmio_read(const volatile uint32_t* p) {
+    __atomic_add_fetch(&n_mmio_reads, 1, __ATOMIC_RELAXED);
+    spin_ns(cfg.peek_ns);
+    if (inject_fault()) return -1;
+    return sim_read(((const char*) p - mmio_window) & (SIM_OCL_SPACE - 1));
+}
+
+void sim_mmio_write(volatile uint32_t* p, uint32_t value) {
+    __atomic_add_fetch(&n_mmio_writes, 1, __ATOMIC_RELAXED);
+    spin_ns(cfg.poke_ns);
+    if (inject_fault()) return;
+    sim_write(((char*) p - mmio_window) & (SIM_OCL_SPACE - 1), value);
+}
+
+int fpga_dma_open_queue(enum fpga_dma_driver which_driver, int slot_id,
+        int channel, bool is_read) {
+    sim_init();
+    int fd = dup(ddr_fd);
+    if (fd < 0) return -1;
+    if (fd >= SIM_MAX_FDS) {
+        __real_close(fd);
+        return -1;
+    }
+    fd_channel[fd] = channel;
+    return fd;
+}
+
+// Applies the DMA cost model to a transfer on a sim fd, and returns the number
+// of bytes the 'driver' will move in this call.
+static ssize_t dma_model(int fd, size_t count) {
+    __atomic_add_fetch(&n_dma_calls, 1, __ATOMIC_RELAXED);
+    if (inject_fault()) {
+        errno = EIO;
+        return -1;
+    }
+    if (cfg.dma_max_xfer > 0 && count > cfg.dma_max_xfer) count = cfg.dma_max_xfer;
+    uint64_t cost = cfg.dma_latency_ns;
+    if (cfg.dma_mbps > 0) cost += (uint64_t) (count * 1000 / cfg.dma_mbps);
+    spin_ns(cost);
+    __atomic_add_fetch(&n_dma_bytes, count, __ATOMIC_RELAXED);
+    return count;
+}
+
+static bool is_sim_fd(int fd) {
+    return initialized && fd >= 0 && fd < SIM_MAX_FDS && fd_channel[fd] >= 0;
+}
+
+ssize_t __wrap_pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    if (!is_sim_fd(fd)) return __real_pwrite(fd, buf, count, offset);
+    ssize_t len = dma_model(fd, count);
+    if (len < 0) return len;
+    return __real_pwrite(fd, buf, len, offset);
+}
+
+ssize_t __wrap_pread(int fd, void* buf, size_t count, off_t offset) {
+    if (!is_sim_fd(fd)) return __real_pread(fd, buf, count, offset);
+    ssize_t len = dma_model(fd, count);
+    if (len < 0) return len;
+    if (cfg.log_rate > 0 && offset >= SIM_LOG_WINDOW) {
+        return log_read(((offset - SIM_LOG_WINDOW) >> 20) & (SIM_MAX_LOG_IDS - 1), buf, len);
+    }
+    return __real_pread(fd, buf, len, offset);
+}
+
+// Forget the channel when a DMA queue is closed, so a later open() that
+// reuses the fd number is not mistaken for a sim fd.
+int __wrap_close(int fd) {
+    if (initialized && fd >= 0 && fd < SIM_MAX_FDS) fd_channel[fd] = -1;
+    return __real_close(fd);
+}
+
+// Same semantics as the SDK: loop until the whole buffer is transferred.
+int fpga_dma_burst_write(int fd, uint8_t *buffer, size_t xfer_sz,
+        size_t address) {
+    size_t done = 0;
+    while (done < xfer_sz) {
+        ssize_t rc = __wrap_pwrite(fd, buffer + done, xfer_sz - done, address + done);
+        if (rc < 0) return -EIO;
+        done += rc;
+    }
+    return 0;
+}
+
+int fpga_dma_burst_read(int fd, uint8_t *buffer, size_t xfer_sz,
+        size_t address) {
+    size_t done = 0;
+    while (done < xfer_sz) {
+        ssize_t rc = __wrap_pread(fd, buffer + done, xfer_sz - done, address + done);
+        if (rc < 0) return -EIO;
+        if (rc == 0) {
+            memset(buffer + done, 0, xfer_sz - done);
+            break;
+        }
+        done += rc;
+    }
+    return 0;
+}
@@ -0,0 +1,372 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Table-driven counter snapshots.
+//
+// stat_regs lists every per-tile status register the runtime knows how to
+// interpret. stat_snapshot() reads the whole table for a range of tiles in
+// one pass; 64-bit counters that the hardware exposes as MSB/LSB pairs are
+// combined there, so callers only ever see uint64_t values.
+// stat_write_json() dumps a snapshot, together with per-tile and aggregate
+// derived metrics, for consumption by scripts.
+
+#include "header.h"
+
+// 32-bit event counter, 32-bit instantaneous value, 64-bit event counter
+#define C32(comp, reg) { #reg, &comp, reg, 0, 32, true }
+#define G32(comp, reg) { #reg, &comp, reg, 0, 32, false }
+#define C64(name, comp, msb, lsb) { name, &comp, msb, lsb, 64, true }
+#define L2(bank, comp, reg) { "L2_" #bank "_" #reg, &comp, L2_##reg, 0, 32, true }
+
+const stat_reg_t stat_regs[] = {
+    G32(ID_TASK_UNIT, TASK_UNIT_N_TASKS),
+    G32(ID_TASK_UNIT, TASK_UNIT_N_TIED_TASKS),
+    G32(ID_TASK_UNIT, TASK_UNIT_LVT),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_UNTIED_ENQ),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_TIED_ENQ_ACK),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_TIED_ENQ_NACK),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_DEQ_TASK),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_SPLITTER_DEQ),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_DEQ_MISMATCH),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_CUT_TIES_MATCH),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_CUT_TIES_MISMATCH),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_CUT_TIES_COM_ABO),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_COMMIT_TIED),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_COMMIT_UNTIED),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_COMMIT_MISMATCH),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_ABORT_CHILD_DEQ),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_ABORT_CHILD_NOT_DEQ),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_ABORT_CHILD_MISMATCH),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_ABORT_TASK),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_COAL_CHILD),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_OVERFLOW),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_N_CYCLES_DEQ_VALID),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_AVG_TASKS),
+    C32(ID_TASK_UNIT, TASK_UNIT_STAT_AVG_HEAP_UTIL),
+    { "TASK_UNIT_STATE_STATS_0", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x00, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_1", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x04, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_2", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x08, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_3", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x0c, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_4", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x10, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_5", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x14, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_6", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x18, 0, 32, true },
+    { "TASK_UNIT_STATE_STATS_7", &ID_TASK_UNIT, TASK_UNIT_STATE_STATS + 0x1c, 0, 32, true },
+
+    G32(ID_CQ, CQ_GVT_TS),
+    C32(ID_CQ, CQ_STAT_N_RESOURCE_ABORTS),
+    C32(ID_CQ, CQ_STAT_N_GVT_ABORTS),
+    C32(ID_CQ, CQ_STAT_N_IDLE_CQ_FULL),
+    C32(ID_CQ, CQ_STAT_N_IDLE_CC_FULL),
+    C32(ID_CQ, CQ_STAT_N_IDLE_NO_TASK),
+    C32(ID_CQ, CQ_STAT_CYCLES_IN_RESOURCE_ABORT),
+    C32(ID_CQ, CQ_STAT_CYCLES_IN_GVT_ABORT),
+    C32(ID_CQ, CQ_N_GVT_GOING_BACK),
+    C32(ID_CQ, CQ_N_TASK_NO_CONFLICT),
+    C32(ID_CQ, CQ_N_TASK_CONFLICT_MITIGATED),
+    C32(ID_CQ, CQ_N_TASK_CONFLICT_MISS),
+    C32(ID_CQ, CQ_N_TASK_REAL_CONFLICT),
+    C64("CQ_CUM_OCC", ID_CQ, CQ_CUM_OCC_MSB, CQ_CUM_OCC_LSB),
+    C64("CQ_N_CUM_COMMIT_CYCLES", ID_CQ, CQ_N_CUM_COMMIT_CYCLES_H, CQ_N_CUM_COMMIT_CYCLES_L),
+    C64("CQ_N_CUM_ABORT_CYCLES", ID_CQ, CQ_N_CUM_ABORT_CYCLES_H, CQ_N_CUM_ABORT_CYCLES_L),
+    { "CQ_STATE_STATS_0", &ID_CQ, CQ_STATE_STATS + 0x00, 0, 32, true },
+    { "CQ_STATE_STATS_1", &ID_CQ, CQ_STATE_STATS + 0x04, 0, 32, true },
+    { "CQ_STATE_STATS_2", &ID_CQ, CQ_STATE_STATS + 0x08, 0, 32, true },
+    { "CQ_STATE_STATS_3", &ID_CQ, CQ_STATE_STATS + 0x0c, 0, 32, true },
+    { "CQ_STATE_STATS_4", &ID_CQ, CQ_STATE_STATS + 0x10, 0, 32, true },
+    { "CQ_STATE_STATS_5", &ID_CQ, CQ_STATE_STATS + 0x14, 0, 32, true },
+    { "CQ_STATE_STATS_6", &ID_CQ, CQ_STATE_STATS + 0x18, 0, 32, true },
+    { "CQ_STATE_STATS_7", &ID_CQ, CQ_STATE_STATS + 0x1c, 0, 32, true },
+
+    G32(ID_SERIALIZER, SERIALIZER_READY_LIST),
+    C32(ID_SERIALIZER, SERIALIZER_CQ_STALL_COUNT),
+    { "SERIALIZER_STAT_NO_TASK",           &ID_SERIALIZER, SERIALIZER_STAT +  0, 0, 32, true },
+    { "SERIALIZER_STAT_CQ_STALL",          &ID_SERIALIZER, SERIALIZER_STAT +  4, 0, 32, true },
+    { "SERIALIZER_STAT_TASK_ISSUED",       &ID_SERIALIZER, SERIALIZER_STAT +  8, 0, 32, true },
+    { "SERIALIZER_STAT_TASK_NOT_ACCEPTED", &ID_SERIALIZER, SERIALIZER_STAT + 12, 0, 32, true },
+    { "SERIALIZER_STAT_NO_THREAD",         &ID_SERIALIZER, SERIALIZER_STAT + 16, 0, 32, true },
+    { "SERIALIZER_STAT_CR_FULL",           &ID_SERIALIZER, SERIALIZER_STAT + 20, 0, 32, true },
+    { "SERIALIZER_STAT_CR_FULL_ALL",       &ID_SERIALIZER, SERIALIZER_STAT + 24, 0, 32, true },
+
+    L2(0, ID_L2_RW, READ_HITS),
+    L2(0, ID_L2_RW, READ_MISSES),
+    L2(0, ID_L2_RW, WRITE_HITS),
+    L2(0, ID_L2_RW, WRITE_MISSES),
+    L2(0, ID_L2_RW, EVICTIONS),
+    L2(0, ID_L2_RW, RETRY_STALL),
+    L2(0, ID_L2_RW, RETRY_NOT_EMPTY),
+    L2(0, ID_L2_RW, RETRY_COUNT),
+    L2(0, ID_L2_RW, STALL_IN),
+    L2(0, ID_L2_RW, PREFETCH_HITS),
+    L2(0, ID_L2_RW, PREFETCH_MISSES),
+    L2(1, ID_L2_RO, READ_HITS),
+    L2(1, ID_L2_RO, READ_MISSES),
+    L2(1, ID_L2_RO, WRITE_HITS),
+    L2(1, ID_L2_RO, WRITE_MISSES),
+    L2(1, ID_L2_RO, EVICTIONS),
+    L2(1, ID_L2_RO, RETRY_STALL),
+    L2(1, ID_L2_RO, RETRY_NOT_EMPTY),
+    L2(1, ID_L2_RO, RETRY_COUNT),
+    L2(1, ID_L2_RO, STALL_IN),
+    L2(1, ID_L2_RO, PREFETCH_HITS),
+    L2(1, ID_L2_RO, PREFETCH_MISSES),
+
+    { "COALESCER_NUM_ENQ", &ID_COALESCER, CORE_NUM_ENQ, 0, 32, true },
+    { "COALESCER_NUM_DEQ", &ID_COALESCER, CORE_NUM_DEQ, 0, 32, true },
+    { "SPLITTER_NUM_ENQ",  &ID_SPLITTER,  CORE_NUM_ENQ, 0, 32, true },
+    { "SPLITTER_NUM_DEQ",  &ID_SPLITTER,  CORE_NUM_DEQ, 0, 32, true },
+};
+const uint32_t n_stat_regs = sizeof(stat_regs) / sizeof(stat_reg_t);
+
+int stat_reg_lookup(const char* name) {
+    for (int i=0;i<n_stat_regs;i++) {
+        if (strcmp(name, stat_regs[i].name) == 0) return i;
+    }
+    return -1;
+}
+
+uint64_t stat_read(uint32_t tile, const stat_reg_t* reg) {
+    uint32_t lsb, msb, msb2;
+    if (reg->width == 32) {
+        pci_peek(tile, *reg->comp, reg->addr, &lsb);
+        return lsb;
+    }
+    // the counter may be live; re-read if the LSB wrapped between the reads
+    pci_peek(tile, *reg->comp, reg->addr, &msb);
+    pci_peek(tile, *reg->comp, reg->addr_lsb, &lsb);
+    pci_peek(tile, *reg->comp, reg->addr, &msb2);
+    if (msb2 != msb) {
+        pci_peek(tile, *reg->comp, reg->addr_lsb, &lsb);
+        msb = msb2;
+    }
+    return ((uint64_t) msb << 32) | lsb;
+}
+
+void stat_snapshot(stat_snapshot_t* s, uint32_t n_tiles) {
+    uint32_t lsb, msb;
+    s->n_tiles = n_tiles;
+    s->values = (uint64_t*) malloc(sizeof(uint64_t) * n_tiles * n_stat_regs);
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb);
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+    s->cycle = ((uint64_t) msb << 32) | lsb;
+    for (uint32_t t=0;t<n_tiles;t++) {
+        for (uint32_t r=0;r<n_stat_regs;r++) {
+            s->values[t * n_stat_regs + r] = stat_read(t, &stat_regs[r]);
+        }
+    }
+}
+
+void stat_snapshot_free(stat_snapshot_t* s) {
+    free(s->values);
+    s->values = NULL;
+}
+
+// d = after - before for cumulative counters; instantaneous values are taken
+// from after. d may alias after.
+void stat_snapshot_delta(stat_snapshot_t* d, const stat_snapshot_t* after,
+        const stat_snapshot_t* before) {
+    if (d != after) {
+        d->n_tiles = after->n_tiles;
+        d->values = (uint64_t*) malloc(sizeof(uint64_t) * after->n_tiles * n_stat_regs);
+    }
+    d->cycle = after->cycle - before->cycle;
+    for (uint32_t t=0;t<after->n_tiles;t++) {
+        for (uint32_t r=0;r<n_stat_regs;r++) {
+            uint32_t i = t * n_stat_regs + r;
+            uint64_t v = after->values[i];
+            if (stat_regs[r].cumulative) {
+                v -= before->values[i];
+                // 32-bit counters may wrap once between snapshots
+                if (stat_regs[r].width == 32) v &= 0xffffffffull;
+            }
+            d->values[i] = v;
+        }
+    }
+}
+
+uint64_t stat_value(const stat_snapshot_t* s, uint32_t tile, const char* name) {
+    int r = stat_reg_lookup(name);
+    if (r < 0) return 0;
+    return s->values[tile * n_stat_regs + r];
+}
+
+// Sum over all tiles
+uint64_t stat_total(const stat_snapshot_t* s, const char* name) {
+    int r = stat_reg_lookup(name);
+    if (r < 0) return 0;
+    uint64_t sum = 0;
+    for (uint32_t t=0;t<s->n_tiles;t++) sum += s->values[t * n_stat_regs + r];
+    return sum;
+}
+
+// Counters of work done by a tile. They stop changing once the tile is idle,
+// unlike the idle and stall cycle counts.
+static const char* quiet_regs[] = {
+    "TASK_UNIT_STAT_N_DEQ_TASK", "TASK_UNIT_STAT_N_COMMIT_TIED",
+    "TASK_UNIT_STAT_N_COMMIT_UNTIED", "TASK_UNIT_STAT_N_ABORT_TASK",
+    "L2_0_READ_HITS", "L2_0_READ_MISSES", "L2_0_WRITE_HITS", "L2_0_WRITE_MISSES",
+    "L2_0_EVICTIONS", "L2_1_READ_HITS", "L2_1_READ_MISSES", "L2_1_WRITE_HITS",
+    "L2_1_WRITE_MISSES", "L2_1_EVICTIONS", "COALESCER_NUM_DEQ", "SPLITTER_NUM_DEQ",
+};
+#define N_QUIET_REGS (sizeof(quiet_regs) / sizeof(quiet_regs[0]))
+#define QUIET_POLL_US 50
+#define QUIET_SAMPLES 3
+
+// Waits until the work counters of the first n_tiles tiles read the same in
+// QUIET_SAMPLES consecutive samples, QUIET_POLL_US apart, e.g. for the tasks
+// in flight to drain after the cores were stopped. Returns nonzero if they
+// were still changing after timeout_us.
+int stat_wait_quiet(uint32_t n_tiles, uint32_t timeout_us) {
+    uint32_t n = n_tiles * N_QUIET_REGS;
+    uint64_t* last = (uint64_t*) calloc(n, sizeof(uint64_t));
+    uint64_t start = timer_ns();
+    uint32_t same = 0;
+    int rc = 1;
+    while (true) {
+        bool changed = false;
+        for (uint32_t t=0;t<n_tiles;t++) {
+            for (uint32_t r=0;r<N_QUIET_REGS;r++) {
+                int id = stat_reg_lookup(quiet_regs[r]);
+                uint64_t v = stat_read(t, &stat_regs[id]);
+                if (v != last[t * N_QUIET_REGS + r]) changed = true;
+                last[t * N_QUIET_REGS + r] = v;
+            }
+        }
+        same = changed ? 1 : same + 1;
+        if (same >= QUIET_SAMPLES) {
+            rc = 0;
+            break;
+        }
+        if (timer_ns() - start > timeout_us * 1000ull) break;
+        usleep(QUIET_POLL_US);
+    }
+    free(last);
+    if (rc) printf("Counters still changing after %u us\n", timeout_us);
+    return rc;
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (a + 0.0) / b : 0.0;
+}
+
+// get(s, i, name) returns a counter for tile i, or the total if i < 0.
+// n_tiles is the number of tiles the counters were summed over, so that
+// fractions of cycles stay within [0, 1] for the aggregate.
+typedef uint64_t (*stat_get_t)(const stat_snapshot_t*, int, const char*);
+
+static uint64_t get_tile(const stat_snapshot_t* s, int tile, const char* name) {
+    return stat_value(s, tile, name);
+}
+
+static uint64_t get_total(const stat_snapshot_t* s, int tile, const char* name) {
+    return stat_total(s, name);
+}
+
+static void write_derived(FILE* fw, const stat_snapshot_t* s, stat_get_t get,
+        int tile, uint32_t n_tiles, uint64_t cycles) {
+#define G(reg) get(s, tile, reg)
+    uint64_t deq = G("TASK_UNIT_STAT_N_DEQ_TASK");
+    uint64_t commits = G("TASK_UNIT_STAT_N_COMMIT_TIED") + G("TASK_UNIT_STAT_N_COMMIT_UNTIED");
+    uint64_t aborts = G("TASK_UNIT_STAT_N_ABORT_TASK");
+    uint64_t tile_cycles = cycles * n_tiles;
+    uint64_t l2_hits = 0, l2_misses = 0, l2_evictions = 0;
+    l2_hits += G("L2_0_READ_HITS") + G("L2_0_WRITE_HITS");
+    l2_hits += G("L2_1_READ_HITS") + G("L2_1_WRITE_HITS");
+    l2_misses += G("L2_0_READ_MISSES") + G("L2_0_WRITE_MISSES");
+    l2_misses += G("L2_1_READ_MISSES") + G("L2_1_WRITE_MISSES");
+    l2_evictions += G("L2_0_EVICTIONS") + G("L2_1_EVICTIONS");
+    uint64_t pf_hits = G("L2_0_PREFETCH_HITS") + G("L2_1_PREFETCH_HITS");
+    uint64_t pf_misses = G("L2_0_PREFETCH_MISSES") + G("L2_1_PREFETCH_MISSES");
+    uint64_t conflicts = G("CQ_N_TASK_NO_CONFLICT") + G("CQ_N_TASK_CONFLICT_MITIGATED") +
+        G("CQ_N_TASK_CONFLICT_MISS") + G("CQ_N_TASK_REAL_CONFLICT");
+    double time_us = cycles / clock_mhz;
+
+    fprintf(fw, "\"derived\": {");
+    fprintf(fw, "\"tasks_dequeued\": %lu, ", deq);
+    fprintf(fw, "\"tasks_committed\": %lu, ", commits);
+    fprintf(fw, "\"tasks_aborted\": %lu, ", aborts);
+    fprintf(fw, "\"abort_ratio\": %.6f, ", ratio(aborts, deq));
+    fprintf(fw, "\"cycles_per_task\": %.3f, ", ratio(tile_cycles, deq));
+    fprintf(fw, "\"avg_tasks\": %.3f, ", ratio(G("TASK_UNIT_STAT_AVG_TASKS"), cycles) * 65536);
+    fprintf(fw, "\"avg_heap_util\": %.3f, ",
+            ratio(G("TASK_UNIT_STAT_AVG_HEAP_UTIL"), cycles) * 65536);
+    fprintf(fw, "\"cq_avg_occupancy\": %.3f, ",
+            ratio(G("CQ_CUM_OCC"), cycles) * (1 << LOG_CQ_SIZE));
+    fprintf(fw, "\"cq_resource_abort_frac\": %.6f, ",
+            ratio(G("CQ_STAT_CYCLES_IN_RESOURCE_ABORT"), tile_cycles));
+    fprintf(fw, "\"cq_gvt_abort_frac\": %.6f, ",
+            ratio(G("CQ_STAT_CYCLES_IN_GVT_ABORT"), tile_cycles));
+    fprintf(fw, "\"cq_idle_no_task_frac\": %.6f, ",
+            ratio(G("CQ_STAT_N_IDLE_NO_TASK"), tile_cycles));
+    fprintf(fw, "\"real_conflict_ratio\": %.6f, ",
+            ratio(G("CQ_N_TASK_REAL_CONFLICT"), conflicts));
+    fprintf(fw, "\"l2_hit_rate\": %.6f, ", ratio(l2_hits, l2_hits + l2_misses));
+    // prefetches that missed, i.e. brought a line in; hits were redundant
+    fprintf(fw, "\"l2_prefetch_fill_ratio\": %.6f, ", ratio(pf_misses, pf_hits + pf_misses));
+    fprintf(fw, "\"mem_read_MBps\": %.3f, ", time_us > 0 ? l2_misses * 64 / time_us : 0.0);
+    fprintf(fw, "\"mem_write_MBps\": %.3f", time_us > 0 ? l2_evictions * 64 / time_us : 0.0);
+    fprintf(fw, "}");
+#undef G
+}
+
+// cycles is the length of the run the counters cover.
+int stat_write_json(const char* path, const stat_snapshot_t* s, uint64_t cycles,
+        const char* app) {
+    FILE* fw = fopen(path, "w");
+    if (fw == NULL) {
+        printf("Unable to open %s\n", path);
+        return 1;
+    }
+    fprintf(fw, "{\n");
+    fprintf(fw, "  \"app\": \"%s\",\n", app);
+    fprintf(fw, "  \"app_id\": %u,\n", APP_ID);
+    fprintf(fw, "  \"n_tiles\": %u,\n", s->n_tiles);
+    fprintf(fw, "  \"cycles\": %lu,\n", cycles);
+    fprintf(fw, "  \"time_ms\": %.6f,\n", cycles / (clock_mhz * 1e3));
+    fprintf(fw, "  \"snapshot_cycle\": %lu,\n", s->cycle);
+    fprintf(fw, "  \"tiles\": [\n");
+    for (uint32_t t=0;t<s->n_tiles;t++) {
+        fprintf(fw, "    {\"tile\": %u, \"counters\": {", t);
+        for (uint32_t r=0;r<n_stat_regs;r++) {
+            fprintf(fw, "%s\"%s\": %lu", r ? ", " : "", stat_regs[r].name,
+                    s->values[t * n_stat_regs + r]);
+        }
+        fprintf(fw, "},\n     ");
+        write_derived(fw, s, get_tile, t, 1, cycles);
+        fprintf(fw, "}%s\n", (t + 1 < s->n_tiles) ? "," : "");
+    }
+    fprintf(fw, "  ],\n");
+    // Instantaneous values do not add up across tiles; only counters are summed
+    fprintf(fw, "  \"total\": {\"counters\": {");
+    bool first = true;
+    for (uint32_t r=0;r<n_stat_regs;r++) {
+        if (!stat_regs[r].cumulative) continue;
+        fprintf(fw, "%s\"%s\": %lu", first ? "" : ", ", stat_regs[r].name,
+                stat_total(s, stat_regs[r].name));
+        first = false;
+    }
+    fprintf(fw, "},\n    ");
+    write_derived(fw, s, get_total, -1, s->n_tiles, cycles);
+    fprintf(fw, "}\n}\n");
+    fclose(fw);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Background telemetry sampler (--telemetry=<file>).
+//
+// While the application runs, a thread reads a set of counters from every
+// active tile each --telemetry_us microseconds and appends them, stamped with
+// OCL_CUR_CYCLE, to a time series. All reads of a sample are issued back to
+// back, and only the LSB of the cycle counter is read per sample (the MSB is
+// tracked across samples), to keep the sampler's share of the OCL bus small.
+//
+// Output is CSV if the file name ends in .csv (one row per sample and tile:
+// cycle,tile,<regs>), and binary otherwise:
+//   char magic[8] = "CHRTLM01"; uint32 n_tiles, n_regs, interval_us, pad;
+//   char names[n_regs][32];
+//   records: { uint64 cycle; uint32 values[n_tiles][n_regs]; }
+
+#include "header.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#define TELEMETRY_MAX_REGS 64
+#define TELEMETRY_BUF_SIZE (1 << 20)
+
+static const char* telemetry_default_regs =
+    "TASK_UNIT_N_TASKS,TASK_UNIT_N_TIED_TASKS,CQ_GVT_TS,"
+    "CQ_STAT_N_RESOURCE_ABORTS,CQ_STAT_N_GVT_ABORTS,"
+    "L2_0_READ_HITS,L2_0_READ_MISSES,SERIALIZER_READY_LIST";
+
+static struct {
+    FILE* fw;
+    bool csv;
+    uint32_t n_tiles;
+    uint32_t n_regs;
+    const stat_reg_t* regs[TELEMETRY_MAX_REGS];
+    uint32_t interval_us;
+    volatile bool stop;
+    pthread_t thread;
+    bool running;
+    uint64_t n_samples;
+    uint64_t sample_ns;   // total time spent reading
+    unsigned char* buf;
+    size_t buf_len;
+} tlm;
+
+static uint64_t telemetry_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void telemetry_emit(const void* data, size_t len) {
+    if (tlm.buf_len + len > TELEMETRY_BUF_SIZE) {
+        fwrite(tlm.buf, 1, tlm.buf_len, tlm.fw);
+        tlm.buf_len = 0;
+    }
+    memcpy(tlm.buf + tlm.buf_len, data, len);
+    tlm.buf_len += len;
+}
+
+static void* telemetry_thread(void* arg) {
+    uint32_t n_values = tlm.n_tiles * tlm.n_regs;
+    uint32_t* values = (uint32_t*) malloc(n_values * sizeof(uint32_t));
+    uint32_t lsb, msb;
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb);
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+    uint64_t cycle = ((uint64_t) msb << 32) | lsb;
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!tlm.stop) {
+        uint64_t t0 = telemetry_now_ns();
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+        for (uint32_t t=0;t<tlm.n_tiles;t++) {
+            for (uint32_t r=0;r<tlm.n_regs;r++) {
+                pci_peek(t, *tlm.regs[r]->comp, tlm.regs[r]->addr,
+                        &values[t * tlm.n_regs + r]);
+            }
+        }
+        tlm.sample_ns += telemetry_now_ns() - t0;
+        tlm.n_samples++;
+
+        // Samples are less than 2^32 cycles apart (interval_us is capped)
+        uint64_t next_cycle = (cycle & ~0xffffffffull) | lsb;
+        if (next_cycle < cycle) next_cycle += 1ull << 32;
+        cycle = next_cycle;
+
+        if (tlm.csv) {
+            char line[64 + TELEMETRY_MAX_REGS * 12];
+            for (uint32_t t=0;t<tlm.n_tiles;t++) {
+                int len = sprintf(line, "%lu,%u", cycle, t);
+                for (uint32_t r=0;r<tlm.n_regs;r++) {
+                    len += sprintf(line + len, ",%u", values[t * tlm.n_regs + r]);
+                }
+                line[len++] = '\n';
+                telemetry_emit(line, len);
+            }
+        } else {
+            telemetry_emit(&cycle, sizeof(cycle));
+            telemetry_emit(values, n_values * sizeof(uint32_t));
+        }
+
+        next.tv_nsec += tlm.interval_us * 1000l;
+        while (next.tv_nsec >= 1000000000l) {
+            next.tv_nsec -= 1000000000l;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    free(values);
+    return NULL;
+}
+
+// regs is a comma-separated list of 32-bit register names from stat_regs, or
+// NULL for the default set.
+int telemetry_start(const char* path, const char* regs, uint32_t interval_us,
+        uint32_t n_tiles) {
+    memset(&tlm, 0, sizeof(tlm));
+    if (regs == NULL || *regs == 0) regs = telemetry_default_regs;
+    char* list = strdup(regs);
+    for (char* tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        int found = stat_reg_lookup(tok);
+        if (found < 0 || stat_regs[found].width != 32) {
+            printf("telemetry: unknown or 64-bit register %s. Available:\n", tok);
+            for (int i=0;i<n_stat_regs;i++) {
+                if (stat_regs[i].width == 32) printf("\t%s\n", stat_regs[i].name);
+            }
+            free(list);
+            return 1;
+        }
+        if (tlm.n_regs == TELEMETRY_MAX_REGS) {
+            printf("telemetry: at most %d registers\n", TELEMETRY_MAX_REGS);
+            free(list);
+            return 1;
+        }
+        tlm.regs[tlm.n_regs++] = &stat_regs[found];
+    }
+    free(list);
+
+    tlm.fw = fopen(path, "w");
+    if (tlm.fw == NULL) {
+        printf("telemetry: unable to open %s\n", path);
+        return 1;
+    }
+    size_t path_len = strlen(path);
+    tlm.csv = (path_len > 4) && (strcmp(path + path_len - 4, ".csv") == 0);
+    tlm.n_tiles = n_tiles;
+    if (interval_us < 10) interval_us = 10;
+    if (interval_us > 10000000) interval_us = 10000000;
+    tlm.interval_us = interval_us;
+    tlm.buf = (unsigned char*) malloc(TELEMETRY_BUF_SIZE);
+
+    if (tlm.csv) {
+        fprintf(tlm.fw, "cycle,tile");
+        for (uint32_t r=0;r<tlm.n_regs;r++) fprintf(tlm.fw, ",%s", tlm.regs[r]->name);
+        fprintf(tlm.fw, "\n");
+    } else {
+        uint32_t hdr[4] = { n_tiles, tlm.n_regs, interval_us, 0 };
+        fwrite("CHRTLM01", 1, 8, tlm.fw);
+        fwrite(hdr, sizeof(uint32_t), 4, tlm.fw);
+        for (uint32_t r=0;r<tlm.n_regs;r++) {
+            char name[32] = {0};
+            strncpy(name, tlm.regs[r]->name, sizeof(name) - 1);
+            fwrite(name, 1, sizeof(name), tlm.fw);
+        }
+    }
+    if (pthread_create(&tlm.thread, NULL, telemetry_thread, NULL)) {
+        printf("telemetry: unable to start sampler\n");
+        fclose(tlm.fw);
+        free(tlm.buf);
+        return 1;
+    }
+    tlm.running = true;
+    return 0;
+}
+
+void telemetry_stop() {
+    if (!tlm.running) return;
+    tlm.stop = true;
+    pthread_join(tlm.thread, NULL);
+    fwrite(tlm.buf, 1, tlm.buf_len, tlm.fw);
+    fclose(tlm.fw);
+    free(tlm.buf);
+    tlm.running = false;
+    printf("telemetry: %lu samples of %u regs x %u tiles, %.1f us per sample\n",
+            tlm.n_samples, tlm.n_regs, tlm.n_tiles,
+            tlm.n_samples ? tlm.sample_ns / 1e3 / tlm.n_samples : 0.0);
+}
@@ -80,7 +80,35 @@ uint32_t active_threads = 0;
 bool logging_on =false;
 uint32_t ddr_throttle_factor = 1;
 uint32_t logging_phase_tasks = 0x100;
-uint32_t reading_binary_file = false;
+bool populate_input = false;
+bool hugepage_input = false;
+int dma_channels = DMA_MAX_CHANNELS;
+bool bulk_enq = true;
+bool mmio_direct = true;
+const char* telemetry_file = NULL;
+const char* telemetry_regs = NULL;
+uint32_t telemetry_us = 1000;
+const char* stats_json_file = NULL;
+const char* log_raw_file = NULL;
+bool log_async = false;
+uint32_t log_watermark = 2048;
+bool ctrl_on = false;
+uint32_t ctrl_ms = 2;
+double ctrl_target = 10;        // percent of finished tasks that aborted
+uint32_t ctrl_margin = 0;       // starting throttle margin; 0 for the default
+const char* ctrl_log_file = "ctrl_log";
+const char* tuned_file = NULL;
+const char* bench_sizes = NULL;
+uint32_t bench_mb = 256;
+uint32_t bench_ocl_reps = 10000;
+double clock_mhz = 0;           // FPGA clock; 0 to measure it
+const char* timing_json_file = NULL;
+const char* query_file = NULL;
+const char* query_out_file = NULL;
+
+const char* app_names[APP_LAST] = {
+    "dma_test", "sssp", "des", "astar", "color", "maxflow", "silo", "rbp"
+};
 
 uint16_t pci_vendor_id = 0x1D0F; /* Amazon PCI Vendor ID */
 uint16_t pci_device_id = 0xF000; /* PCI Device ID preassigned by Amazon for F1 applications */
@@ -89,7 +117,7 @@ uint16_t pci_device_id = 0xF000; /* PCI Device ID preassigned by Amazon for F1 a
 
 int peek_poke_example(int slot, int pf_id, int bar_id);
 int test_task_unit(int slot, int pf_id, int bar_id);
-int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int);
+int test_chronos(int slot_id, int pf_id, int bar_id, const char* input_file, int);
 int vled_example(int slot);
 
 /* Declating auxilary house keeping functions */
@@ -97,13 +125,23 @@ int initialize_log(char* log_name);
 int check_afi_ready(int slot);
 
 FILE* fhex;
-int write_fd;
 int read_fd;
 
 
+// BAR0 mapped by pci_map_bar(), or NULL to go through fpga_pci_peek/poke
+static volatile uint32_t* ocl_bar = NULL;
+// Inside pci_batch_begin/end: write errors are counted rather than fatal
+static __thread bool pci_batching = false;
+static __thread uint32_t pci_batch_errors;
+
 void pci_peek(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t* data) {
     uint32_t ocl_addr = (tile << 16) + (comp << 8) + addr;
-    int rc = fpga_pci_peek(pci_bar_handle, ocl_addr, data);
+    int rc = 0;
+    if (ocl_bar != NULL) {
+        *data = OCL_MMIO_READ(ocl_bar + (ocl_addr >> 2));
+    } else {
+        rc = fpga_pci_peek(pci_bar_handle, ocl_addr, data);
+    }
 
     if ( (rc != 0) |
             ( 1 & ( (*data == -1) & !((comp == ID_CQ) & (addr == CQ_GVT_TS)))) ) {
@@ -113,12 +151,77 @@ void pci_peek(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t* data) {
 }
 void pci_poke(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t data) {
     uint32_t ocl_addr = (tile << 16) + (comp << 8) + addr;
+    if (ocl_bar != NULL) {
+        // A posted store; failures only show up at the next read
+        OCL_MMIO_WRITE(ocl_bar + (ocl_addr >> 2), data);
+        if (resident != NULL) resident_shadow_store(ocl_addr, data);
+        return;
+    }
     int rc = fpga_pci_poke(pci_bar_handle, ocl_addr, data);
     if (rc != 0) {
+        if (pci_batching) {
+            pci_batch_errors++;
+            return;
+        }
         printf("Unable to write to OCL addr=%8x, data=%d\n", ocl_addr, data);
-        exit(0);
+        exit(1);
+    }
+    if (resident != NULL) resident_shadow_store(ocl_addr, data);
+}
+
+// pci_poke for configuration registers, which hold what was last written to
+// them: under the daemon, writes of the value the register already holds
+// are skipped.
+uint32_t pci_config_writes, pci_config_skipped;
+void pci_config(uint32_t tile, uint32_t comp, uint32_t addr, uint32_t data) {
+    uint32_t ocl_addr = (tile << 16) + (comp << 8) + addr;
+    pci_config_writes++;
+    if (resident != NULL && resident_shadow_match(ocl_addr, data)) {
+        pci_config_skipped++;
+        return;
+    }
+    pci_poke(tile, comp, addr, data);
+}
+
+// Maps BAR0 so that pci_peek/poke become plain 32-bit loads and stores,
+// rather than library calls. Returns nonzero, leaving the library path in
+// place, if the BAR cannot be mapped.
+int pci_map_bar() {
+    void* bar;
+    int rc = fpga_pci_get_address(pci_bar_handle, 0, OCL_BAR_SIZE / 4, &bar);
+    if (rc != 0) {
+        printf("Unable to map BAR0 (%d), using fpga_pci_peek/poke\n", rc);
+        return 1;
+    }
+    ocl_bar = (volatile uint32_t*) bar;
+    return 0;
+}
+
+void pci_unmap_bar() {
+    ocl_bar = NULL;
+}
+
+// Pokes between pci_batch_begin() and pci_batch_end() are issued back to back
+// and checked once at the end: a read of OCL_PARAM_N_TILES, which PCIe
+// orders after all of them, fences the batch. A dead link reads all ones.
+// Returns nonzero if any of the writes may have been lost.
+void pci_batch_begin() {
+    pci_batching = true;
+    pci_batch_errors = 0;
+}
+
+int pci_batch_end() {
+    uint32_t n_tiles;
+    pci_batching = false;
+    pci_peek(0, ID_OCL_SLAVE, OCL_PARAM_N_TILES, &n_tiles);
+    if (pci_batch_errors > 0 || n_tiles == 0xffffffff) {
+        printf("OCL write batch failed: %d errors, fence read %x\n",
+                pci_batch_errors, n_tiles);
+        return 1;
     }
+    return 0;
 }
+
 void init_params() {
 
     pci_peek(0, ID_OCL_SLAVE, OCL_PARAM_APP_ID, &APP_ID);
@@ -168,39 +271,61 @@ void init_params() {
 
 }
 
-int prefix(const char* pre, char* str) {
-    return strncmp(pre, str, strlen(pre)) ==0;
+// Apps whose task objects index an array of fixed-size records in the input.
+// The prefetcher of the non-pipelined cores fetches the record of every task
+// enqueued to the tile; base is a word offset, as in the headers.
+bool prefetch_target(int app, const uint32_t* headers, uint32_t* base,
+        uint32_t* log_size) {
+    switch (app) {
+        case APP_SSSP:
+        case APP_ASTAR:
+            *base = headers[5]; *log_size = 2; // dist
+            return true;
+        case APP_COLOR:
+            *base = headers[5]; *log_size = 4; // color_node_prop_t
+            return true;
+        case APP_MAXFLOW:
+            *base = headers[5]; *log_size = 6; // maxflow_node_prop_t
+            return true;
+    }
+    return false;
 }
 
-int main(int argc, char **argv) {
-    int rc;
-    int slot_id;
-
-    char* usage = "Usage ./test_chronos <--options=val> app <input> <riscv_hex_file>";
-    if (argc <2)  {
-        printf("%s\n", usage);
-        exit(0);
+// Flushes both L2 banks of every tile and waits for all of them; the flushes
+// run in parallel. L2_FLUSH reads 1 while a flush is in progress. Returns
+// nonzero if some bank was still flushing after timeout_us.
+int l2_flush(uint32_t n_tiles, uint32_t timeout_us) {
+    for (int i=0;i<n_tiles;i++) {
+        pci_poke(i, ID_L2_RW, L2_FLUSH, 1);
+        pci_poke(i, ID_L2_RO, L2_FLUSH, 1);
     }
-    /* initialize the fpga_plat library */
-    rc = fpga_mgmt_init();
-    fail_on(rc, out, "Unable to initialize the fpga_mgmt library");
-
-    /* initialize the fpga_pci library so we could have access to FPGA PCIe from this applications */
-    rc = fpga_pci_init();
-    fail_on(rc, out, "Unable to initialize the fpga_pci library");
-
-    /* This demo works with single FPGA slot, we pick slot #0 as it works for both f1.2xl and f1.16xl */
-    pci_bar_handle = PCI_BAR_HANDLE_INIT;
-
-    slot_id = 0;
-
-    rc = check_afi_ready(slot_id);
-    fail_on(rc, out, "AFI not ready");
+    uint64_t start = timer_ns();
+    while (true) {
+        uint32_t busy = 0;
+        uint32_t ocl_data;
+        for (int i=0;i<n_tiles;i++) {
+            pci_peek(i, ID_L2_RW, L2_FLUSH, &ocl_data);
+            busy += (ocl_data == 1);
+            pci_peek(i, ID_L2_RO, L2_FLUSH, &ocl_data);
+            busy += (ocl_data == 1);
+        }
+        if (busy == 0) return 0;
+        if (timer_ns() - start > timeout_us * 1000ull) {
+            printf("Flush did not complete on %d banks\n", busy);
+            return 1;
+        }
+        usleep(100);
+    }
+}
 
+int prefix(const char* pre, char* str) {
+    return strncmp(pre, str, strlen(pre)) ==0;
+}
 
-    int n_options = 0;
-    int cur_arg = 1;
-    while( prefix("--", argv[cur_arg])){
+// Parses the --options from argv[cur_arg] on; returns the index of the first
+// argument that is not one.
+int parse_options(int argc, char** argv, int cur_arg) {
+    while (cur_arg < argc && prefix("--", argv[cur_arg])) {
         const char* val = strstr(argv[cur_arg], "=");
         val++; // skip the '=' sign
         printf("opt %s %s\n", argv[cur_arg], val);
@@ -210,18 +335,46 @@ int main(int argc, char **argv) {
         if (prefix("--rate_ctrl", argv[cur_arg])) {
             ddr_throttle_factor = atoi(val);
         }
+        if (prefix("--populate", argv[cur_arg])) populate_input = (atoi(val)==1);
+        if (prefix("--hugepages", argv[cur_arg])) hugepage_input = (atoi(val)==1);
+        if (prefix("--dma_channels", argv[cur_arg])) dma_channels = atoi(val);
+        if (prefix("--bulk_enq", argv[cur_arg])) bulk_enq = (atoi(val)==1);
+        if (prefix("--mmio", argv[cur_arg])) mmio_direct = (atoi(val)==1);
+        if (prefix("--telemetry=", argv[cur_arg])) telemetry_file = val;
+        if (prefix("--telemetry_us", argv[cur_arg])) telemetry_us = atoi(val);
+        if (prefix("--telemetry_regs", argv[cur_arg])) telemetry_regs = val;
+        if (prefix("--stats_json", argv[cur_arg])) stats_json_file = val;
+        if (prefix("--timing_json", argv[cur_arg])) timing_json_file = val;
+        if (prefix("--queries", argv[cur_arg])) query_file = val;
+        if (prefix("--query_out", argv[cur_arg])) query_out_file = val;
+        if (prefix("--clock_mhz", argv[cur_arg])) clock_mhz = atof(val);
+        if (prefix("--log_raw", argv[cur_arg])) log_raw_file = val;
+        if (prefix("--log_async", argv[cur_arg])) log_async = (atoi(val)==1);
+        if (prefix("--log_watermark", argv[cur_arg])) log_watermark = atoi(val);
+        if (prefix("--ctrl=", argv[cur_arg])) ctrl_on = (atoi(val)==1);
+        if (prefix("--ctrl_ms", argv[cur_arg])) ctrl_ms = atoi(val);
+        if (prefix("--ctrl_target", argv[cur_arg])) ctrl_target = atof(val);
+        if (prefix("--ctrl_margin", argv[cur_arg])) ctrl_margin = atoi(val);
+        if (prefix("--ctrl_log", argv[cur_arg])) ctrl_log_file = val;
+        if (prefix("--config", argv[cur_arg])) {
+            if (param_load_config(val)) exit(1);
+        }
+        if (prefix("--tuned", argv[cur_arg])) tuned_file = val;
+        if (prefix("--bench_sizes", argv[cur_arg])) bench_sizes = val;
+        if (prefix("--bench_mb", argv[cur_arg])) bench_mb = atoi(val);
+        if (prefix("--bench_ocl_reps", argv[cur_arg])) bench_ocl_reps = atoi(val);
+        param_parse_option(argv[cur_arg]);
 
         cur_arg++;
     }
+    return cur_arg;
+}
 
+// Runs "app input [riscv_hex_file]" from argv[cur_arg]
+int run_app(int slot_id, int argc, char** argv, int cur_arg) {
     int app = -1; // Invalid number
-    FILE* fg;
     fhex = 0;
     char* str_app = argv[cur_arg];
-    if (strcmp(str_app, "dma_test") ==0) {
-        dma_example(slot_id);
-        exit(0);
-    }
     if (strcmp(str_app, "sssp") ==0) {
         app = APP_SSSP;
     }
@@ -243,28 +396,68 @@ int main(int argc, char **argv) {
     if (strcmp(str_app, "rbp") ==0) {
         app = APP_RBP;
     }
-    if (argc >=4 ) fhex = fopen(argv[cur_arg+2], "r"); // code hex
-    if ( (app > 0) & (argc <3)) {
+    if (app == -1) {
+        printf("Invalid app\n"); exit(1);
+    }
+    if (cur_arg + 1 >= argc) {
         printf("Need input file\n");
-        exit(0);
+        exit(1);
     }
-    // Read the first word to determine if file is binary
+    if (cur_arg + 2 < argc) fhex = fopen(argv[cur_arg+2], "r"); // code hex
     printf("Opening input file %s\n", argv[cur_arg+1]);
-    fg = fopen(argv[cur_arg+1], "rb");
-    fail_on((rc = (fg == 0)? 1:0), out, "unable to open input file. ");
-    uint32_t magic_op;
-    fread( &magic_op, 1, 4, fg);
-    printf("MAGIC_OP %x\n", magic_op);
-    reading_binary_file = (magic_op == 0xdead);
-    if (!reading_binary_file) {
-        fclose(fg);
-        fg=fopen(argv[cur_arg+1], "r");
+    return test_chronos(slot_id, FPGA_APP_PF, APP_PF_BAR0, argv[cur_arg+1], app);
+}
+
+int main(int argc, char **argv) {
+    int rc;
+    int slot_id;
+
+    char* usage = "Usage ./test_chronos <--options=val> app <input> <riscv_hex_file>";
+    if (argc <2)  {
+        printf("%s\n", usage);
+        exit(1);
     }
-    if (app == -1) {
-        printf("Invalid app\n"); exit(0);
+    /* initialize the fpga_plat library */
+    rc = fpga_mgmt_init();
+    fail_on(rc, out, "Unable to initialize the fpga_mgmt library");
+
+    /* initialize the fpga_pci library so we could have access to FPGA PCIe from this applications */
+    rc = fpga_pci_init();
+    fail_on(rc, out, "Unable to initialize the fpga_pci library");
+
+    /* This demo works with single FPGA slot, we pick slot #0 as it works for both f1.2xl and f1.16xl */
+    pci_bar_handle = PCI_BAR_HANDLE_INIT;
+
+    slot_id = 0;
+
+    rc = check_afi_ready(slot_id);
+    fail_on(rc, out, "AFI not ready");
+
+
+    int cur_arg = parse_options(argc, argv, 1);
+    if (cur_arg >= argc) {
+        printf("%s\n", usage);
+        exit(1);
     }
-    test_chronos(slot_id, FPGA_APP_PF, APP_PF_BAR0, fg, app);
-    return 0;
+
+    char* str_app = argv[cur_arg];
+    if (strcmp(str_app, "dma_test") ==0) {
+        dma_example(slot_id);
+        exit(0);
+    }
+    if (strcmp(str_app, "bench") ==0) {
+        const char* path = (cur_arg + 1 < argc) ? argv[cur_arg+1] : "bench.tsv";
+        bench_run(slot_id, FPGA_APP_PF, APP_PF_BAR0, path, bench_sizes,
+                bench_mb, bench_ocl_reps, dma_channels);
+        exit(0);
+    }
+    if (strcmp(str_app, "daemon") ==0) {
+        const char* path = (cur_arg + 1 < argc) ? argv[cur_arg+1] : DAEMON_SOCKET;
+        if (attach_slot(slot_id, FPGA_APP_PF, APP_PF_BAR0)) exit(1);
+        daemon_run(slot_id, path);
+        exit(0);
+    }
+    return run_app(slot_id, argc, argv, cur_arg);
 
 out:
     return 1;
@@ -325,33 +518,6 @@ rand_string(char *str, size_t size)
     str[size-1] = '\0';
 }
 
-void dma_write(unsigned char* write_buffer, uint32_t write_len, size_t write_addr) {
-
-    size_t write_offset = 0;
-    int rc;
-    // After moving to v1.4, dma transfers larger than 512 B doesn't work.
-    // Not sure why this happens; but temp fix by splitting larger transfers to
-    // 512 B chunks.
-    uint32_t chunk_size = 512;
-    while (write_offset < write_len) {
-        if (write_offset != 0) {
-            //    printf("Partial write by driver, trying again with remainder of buffer (%lu bytes)\n",
-            //          write_len - write_offset);
-        }
-        //rc = fpga_dma_burst_write(write_fd,
-        rc = pwrite(write_fd,
-                write_buffer + write_offset,
-                (write_len - write_offset) > chunk_size ? chunk_size: (write_len - write_offset) ,
-                write_addr + write_offset);
-        if (rc < 0) {
-            printf("call to pwrite failed.\n");
-        }
-        //printf("rc %d\n", rc);
-        write_offset += rc;
-    }
-    rc = 0;
-
-}
 uint32_t hti(char c) {
     if (c >= 'A' && c <= 'F')
         return c - 'A' + 10;
@@ -411,7 +577,7 @@ void load_code() {
                     else if (offset == code_start) reading_code = true;
                     else {
                         printf("unexpect offset\n");
-                        exit(0);
+                        exit(1);
                     }
                     break;
                 default:
@@ -450,45 +616,54 @@ void load_code() {
     //    printf("unable to open read dma queue\n");
     //    exit(0);
    // }
-    dma_write(code_buffer, code_len, code_start);
-    dma_write(data_buffer, code_len, data_start);
+    if (dma_write(code_buffer, code_len, code_start) != 0 ||
+            dma_write(data_buffer, code_len, data_start) != 0) {
+        printf("unable to write_dma (riscv code)\n");
+        exit(1);
+    }
 }
 
-int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
-    int rc;
-    unsigned char *write_buffer, *read_buffer;
-
-    read_buffer = NULL;
-    write_buffer = NULL;
-    write_fd = -1;
-    read_fd = -1;
-
-
+// Checks the AFI, opens the DMA queues, attaches to (and maps) BAR0 and reads
+// the system parameters.
+int attach_slot(int slot_id, int pf_id, int bar_id) {
     /* make sure the AFI is loaded and ready */
-    rc = check_slot_config(slot_id);
+    int rc = check_slot_config(slot_id);
     if (rc >0) {
         printf("slot config is not correct\n");
-        exit(0);
+        return 1;
     }
 
-    write_fd = fpga_dma_open_queue(FPGA_DMA_XDMA, slot_id,
-            /*channel*/ 1, /*is_read*/ false);
-    if(write_fd<0){
-        printf("unable to open write dma queue\n");
-        exit(0);
-    }
-    read_fd = fpga_dma_open_queue(FPGA_DMA_XDMA, slot_id,
-            /*channel*/ 0, /*is_read*/ true);
-    if(read_fd<0){
-        printf("unable to open read dma queue\n");
-        exit(0);
+    if (dma_init(slot_id, dma_channels)) {
+        return 1;
     }
+    read_fd = dma_read_fd();
     rc = fpga_pci_attach(slot_id, pf_id, bar_id, 0, &pci_bar_handle);
     if (rc > 0) {
         printf("Unable to attach to the AFI on slot id %d\n", slot_id);
-        exit(0);
+        return 1;
     }
+    if (mmio_direct) pci_map_bar();
     init_params();
+    return 0;
+}
+
+int test_chronos(int slot_id, int pf_id, int bar_id, const char* input_file, int app) {
+    int rc;
+    unsigned char *write_buffer, *read_buffer;
+    chronos_input_t input;
+
+    read_buffer = NULL;
+    write_buffer = NULL;
+    read_fd = -1;
+
+
+    stage_begin("setup");
+    // The daemon has done this once for all of its jobs
+    if (resident == NULL) {
+        if (attach_slot(slot_id, pf_id, bar_id)) exit(1);
+    }
+    // The FPGA clock is measured over the whole run
+    fpga_clock_start();
 
 
     // Change here if you want to reduce the system size
@@ -496,49 +671,47 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     // color precompiled image does not support max_concurrent tasks
     // FIXME
     if (active_threads == 1 & (app != APP_COLOR)) max_threads = 1;
+    // astar - 900
+    // sssp - 5000
+    uint32_t throttle_margin = (app == APP_ASTAR) ? 900 : 5000;
+    if (ctrl_margin > 0) throttle_margin = ctrl_margin;
 
     if (N_TILES < active_tiles) {
         printf("N_TILES %d < active_tiles %d\n", N_TILES, active_tiles);
-        exit(0);
+        exit(1);
     }
 
     // Stage 1: Read input file and transfer to the FPGA
-    printf("File %p\n", fg);
-    write_buffer = (unsigned char *)malloc(1600*1024*1024);
-    uint32_t* headers = (uint32_t*) write_buffer;
-    long lSize;
-    if (reading_binary_file) {
-       fseek (fg , 0 , SEEK_END);
-       lSize = ftell (fg);
-       printf("File %p size %ld\n", fg, lSize);
-       rewind (fg);
-       fread( (void*) write_buffer, 1, lSize, fg);
-       for (int i=0;i<16;i++) {
-            printf("headers %d %x \n", i, headers[i]);
-       }
-    } else {
-        uint32_t line;
-        int ret;
-        int n = 0;
-        while ( (ret = fscanf(fg,"%8x\n", &line)) != EOF) {
-            //line = n;
-            write_buffer[n ] = line & 0xff;
-            write_buffer[n +1] = (line >>8) & 0xff;
-            write_buffer[n +2] = (line >>16) & 0xff;
-            write_buffer[n +3] = (line >>24) & 0xff;
-            if (n<64) headers[n/4] = line;
-            n+=4;
-        }
-        printf("File Len %d\n", n);
-        lSize = n;
+    stage_begin("file_read");
+    if (load_input(input_file, &input, populate_input, hugepage_input)) {
+        exit(1);
+    }
+    // before the header patches below
+    uint64_t input_hash = 0;
+    if (resident != NULL) input_hash = resident_hash(input_file, &input);
+    stage_begin("header_patch");
+    write_buffer = input.data;
+    uint32_t* headers = input.headers;
+    size_t lSize = input.len;
+    printf("File %s size %lu\n", input_file, lSize);
+    for (int i=0;i<16;i++) {
+        printf("headers %d %x \n", i, headers[i]);
+    }
+    char in_class[32];
+    input_class(in_class, sizeof(in_class), headers);
+    printf("input class %s\n", in_class);
+    if (tuned_file != NULL) {
+        param_load_tuned(tuned_file, app_names[app], in_class);
     }
     if (app == APP_MAXFLOW) {
         uint32_t log_gr_interval = headers[10];
         // global relabel interval
         bool adjust_relabel_interval = true;
+        // manually tuned
+        param_default(PARAM_GR_INTERVAL_BIAS, (APP_ID == RISCV_ID) ? 3 : 5);
         if (adjust_relabel_interval) {
-            log_gr_interval += -(int) log2(active_tiles) + 5;
-            if (APP_ID == RISCV_ID) log_gr_interval -=2; // manually tuned
+            log_gr_interval += -(int) log2(active_tiles) +
+                param(PARAM_GR_INTERVAL_BIAS);
             if (log_gr_interval < 5) log_gr_interval = 5;
 
         }
@@ -551,8 +724,9 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
         headers[15] = 0; // bfs non-spec
     }
     if (app == APP_COLOR) {
-        headers[9] = 96;
-        write_buffer[9*4] = headers[9];
+        param_default(PARAM_COLOR_CHUNK, 96);
+        param_default(PARAM_PRODUCER_THRESHOLD, 100);
+        headers[9] = param(PARAM_COLOR_CHUNK);
     }
     if (app == APP_DES) {
         headers[13] = 1;
@@ -576,13 +750,19 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
     uint32_t startCycle, endCycle;
 
-    int file_len = lSize;
+    size_t file_len = lSize;
     read_buffer = (unsigned char *)malloc(headers[1]*4);
+    stage_begin("input_dma");
     pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &startCycle);
-    rc =fpga_dma_burst_write(write_fd, write_buffer, file_len, 0);
+    dma_stats_reset();
+    if (resident != NULL) {
+        rc = resident_upload(app, &input, input_hash);
+    } else {
+        rc = dma_write(write_buffer, file_len, 0);
+    }
     pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &endCycle);
     printf("Write input data: cycles from %d %d\n", startCycle, endCycle);
-    rc = 0;
+    dma_stats("Write input data");
 
     uint32_t* csr_offset = (uint32_t *) (write_buffer + headers[3]*4);
     uint32_t* csr_neighbors = (uint32_t *) (write_buffer + headers[4]*4);
@@ -590,10 +770,11 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
     if(rc!=0){
         printf("unable to write_dma\n");
-        exit(0);
+        exit(1);
     }
 
 
+    stage_begin("code_load");
     if (fhex) {
         // If running on risc-v cores
         load_code();
@@ -602,6 +783,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
 
     // Stage 2: Intialize Task-spilling data structures
+    stage_begin("spill_init");
     unsigned char* spill_area = (unsigned char*) malloc(TOTAL_SPILL_ALLOCATION);
     for (int i=0;i<4;i++) spill_area[STACK_PTR_ADDR_OFFSET +i] = 0;
     for (int i=0;i< (1<<LOG_SPLITTER_STACK_SIZE) ; i++) {
@@ -613,17 +795,21 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     }
 
     for (int i=0;i<N_TILES;i++) {
-        dma_write(spill_area,
+        if (dma_write(spill_area,
                 SCRATCHPAD_END_OFFSET,
-                ADDR_BASE_SPILL + i*TOTAL_SPILL_ALLOCATION);
+                ADDR_BASE_SPILL + i*TOTAL_SPILL_ALLOCATION) != 0) {
+            printf("unable to write_dma (spill area, tile %d)\n", i);
+            exit(1);
+        }
     }
     uint64_t cycles;
     int num_errors = 0;
+    bool readback_failed = false;
 
-    uint32_t ocl_data = 0;
 
 
     // Stage 3: Global Initialization
+    stage_begin("ocl_config");
 
     // for debug logs (if enabled in config)
     FILE* fwtu = fopen("task_unit_log", "w");
@@ -639,8 +825,17 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     FILE* fwl2ro = fopen("l2_ro", "w");
     FILE* fwrv_0 = fopen("riscv_log_0", "w");
     unsigned char* log_buffer = (unsigned char *)malloc(20000*64);
+    if (log_raw_file != NULL) {
+        if (log_raw_open(log_raw_file)) exit(1);
+    }
 
-    sleep(1);
+    // Wait for the FPGA to be clocked, rather than a fixed second
+    uint64_t t_wait = timer_ns();
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &startCycle);
+    do {
+        usleep(10);
+        pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &endCycle);
+    } while (endCycle == startCycle && timer_ns() - t_wait < 1000000000ull);
 
 
     // OCL Initialization
@@ -652,16 +847,38 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     if (endCycle == startCycle) return -1;
 
 
-    uint32_t tied_cap = 1<<(LOG_TQ_SIZE -2);
-    uint32_t clean_threshold = 40;
-    uint32_t spill_threshold = (1<<LOG_TQ_SIZE) - 500;
-    //tied_cap = 100;
-    //tied_cap = 0;
-    //spill_threshold = 1500;
-    uint32_t spill_size = 240;
-
-    uint32_t deq_tolerance = 3;
-    uint32_t pre_enq_fifo_thresh = 1;
+    param_default(PARAM_TIED_CAP, 1<<(LOG_TQ_SIZE -2));
+    param_default(PARAM_CLEAN_THRESHOLD, 40);
+    param_default(PARAM_SPILL_THRESHOLD, (1<<LOG_TQ_SIZE) - 500);
+    param_default(PARAM_SPILL_SIZE, 240);
+    param_default(PARAM_DEQ_TOLERANCE, 3);
+    param_default(PARAM_PRE_ENQ_FIFO_THRESH, 1);
+    param_default(PARAM_PREFETCH_CAPACITY, 0);
+    param_print();
+    // for tune.py, which samples within the asserts below
+    printf("param limits log_tq_size=%d tq_stages=%d log_cq_size=%d spillq_stages=%d\n",
+            LOG_TQ_SIZE, TQ_STAGES, LOG_CQ_SIZE, SPILLQ_STAGES);
+
+    uint32_t tied_cap = param(PARAM_TIED_CAP);
+    uint32_t clean_threshold = param(PARAM_CLEAN_THRESHOLD);
+    uint32_t spill_threshold = param(PARAM_SPILL_THRESHOLD);
+    uint32_t spill_size = param(PARAM_SPILL_SIZE);
+
+    uint32_t deq_tolerance = param(PARAM_DEQ_TOLERANCE);
+    uint32_t pre_enq_fifo_thresh = param(PARAM_PRE_ENQ_FIFO_THRESH);
+    uint32_t prefetch_capacity = param(PARAM_PREFETCH_CAPACITY);
+    uint32_t prefetch_base = 0, prefetch_log_size = 0;
+    bool prefetch_config = !USING_PIPELINED_TEMPLATE &&
+        prefetch_target(app, headers, &prefetch_base, &prefetch_log_size);
+    if (prefetch_capacity > 0) {
+        if (prefetch_config) {
+            printf("L2 prefetch capacity %d base %x object size %d\n",
+                    prefetch_capacity, prefetch_base, 1 << prefetch_log_size);
+        } else {
+            // the pipelined RW stage computes the address itself
+            printf("L2 prefetch capacity %d\n", prefetch_capacity);
+        }
+    }
 
 
     assert(spill_threshold > (tied_cap + (1<<LOG_CQ_SIZE) + spill_size));
@@ -669,13 +886,15 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     assert(spill_size < (1<<SPILLQ_STAGES) );
     assert(tied_cap < (1<<LOG_TQ_SIZE) );
     assert(clean_threshold < (1<<TQ_STAGES) );
+    assert(prefetch_capacity <= 32);
     printf("Spill Alloc %08x %08x\n",ADDR_BASE_SPILL, TOTAL_SPILL_ALLOCATION);
 
     //pci_poke(N_TILES, ID_GLOBAL, MEM_XBAR_NUM_CTRL, 4);
     if (ddr_throttle_factor > 1) {
-        pci_poke(N_TILES, ID_GLOBAL, MEM_XBAR_RATE_CTRL, (1<<16) | ddr_throttle_factor);
+        pci_config(N_TILES, ID_GLOBAL, MEM_XBAR_RATE_CTRL, (1<<16) | ddr_throttle_factor);
     }
 
+    pci_batch_begin();
     for (int i=0;i<N_TILES;i++) {
 
         // configure base addresses
@@ -688,62 +907,71 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
             }
         } else {
             for (int j=0;j<16;j++) {
-                pci_poke(i, ID_ALL_APP_CORES, j*4, headers[j]);
+                pci_config(i, ID_ALL_APP_CORES, j*4, headers[j]);
             }
         }
-        pci_poke(i, ID_RW_READ, CORE_FIFO_OUT_ALMOST_FULL_THRESHOLD, 14);
-        pci_poke(i, ID_RW_WRITE, CORE_FIFO_OUT_ALMOST_FULL_THRESHOLD, 14);
-        pci_poke(i, ID_RO_STAGE, CORE_FIFO_OUT_ALMOST_FULL_THRESHOLD, 14);
-        pci_poke(i, ID_SERIALIZER, SERIALIZER_N_THREADS,
+        pci_config(i, ID_RW_READ, CORE_FIFO_OUT_ALMOST_FULL_THRESHOLD, 14);
+        pci_config(i, ID_RW_WRITE, CORE_FIFO_OUT_ALMOST_FULL_THRESHOLD, 14);
+        pci_config(i, ID_RO_STAGE, CORE_FIFO_OUT_ALMOST_FULL_THRESHOLD, 14);
+        pci_config(i, ID_SERIALIZER, SERIALIZER_N_THREADS,
                 (USING_PIPELINED_TEMPLATE & (active_threads > 0)) ? active_threads : 16 );
 
         // Spilling config
-        pci_poke(i, ID_COAL_AND_SPLITTER, SPILL_ADDR_STACK_PTR ,
+        pci_config(i, ID_COAL_AND_SPLITTER, SPILL_ADDR_STACK_PTR ,
                 (ADDR_BASE_SPILL + i*TOTAL_SPILL_ALLOCATION) >> 6 );
-        pci_poke(i, ID_COAL_AND_SPLITTER, SPILL_BASE_STACK ,
+        pci_config(i, ID_COAL_AND_SPLITTER, SPILL_BASE_STACK ,
                 (ADDR_BASE_SPILL + i*TOTAL_SPILL_ALLOCATION + STACK_BASE_OFFSET) >> 6 );
-        pci_poke(i, ID_COAL_AND_SPLITTER, SPILL_BASE_SCRATCHPAD ,
+        pci_config(i, ID_COAL_AND_SPLITTER, SPILL_BASE_SCRATCHPAD ,
                 (ADDR_BASE_SPILL + i*TOTAL_SPILL_ALLOCATION + SCRATCHPAD_BASE_OFFSET) >> 6 );
-        pci_poke(i, ID_COAL_AND_SPLITTER, SPILL_BASE_TASKS ,
+        pci_config(i, ID_COAL_AND_SPLITTER, SPILL_BASE_TASKS ,
                 (ADDR_BASE_SPILL + i*TOTAL_SPILL_ALLOCATION + SPILL_TASK_BASE_OFFSET) >> 6 );
 
-        pci_poke(i, ID_TSB, TSB_LOG_N_TILES        , active_tiles );
-        pci_poke(i, ID_SERIALIZER, SERIALIZER_N_MAX_RUNNING_TASKS , max_threads );
+        pci_config(i, ID_TSB, TSB_LOG_N_TILES        , active_tiles );
+        pci_config(i, ID_SERIALIZER, SERIALIZER_N_MAX_RUNNING_TASKS , max_threads );
         if (app != APP_ASTAR) {
             // astar relies on simple mapping to send termination tasks to all
             // tiles
-            pci_poke(i, ID_TSB, TSB_HASH_KEY       , 1);
+            pci_config(i, ID_TSB, TSB_HASH_KEY       , 1);
         }
-        pci_poke(i, ID_L2_RW, L2_CIRCULATE_ON_STALL  , 1);
-        pci_poke(i, ID_L2_RO, L2_CIRCULATE_ON_STALL  , 1);
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_SPILL_THRESHOLD, spill_threshold);
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_CLEAN_THRESHOLD, clean_threshold);
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_TIED_CAPACITY, tied_cap);
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_SPILL_SIZE, spill_size);
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_SPILL_CHECK_LIMIT, spill_size * 16);
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_ALT_DEBUG, 0); // get enq args instead of deq object/ts
-
-        pci_poke(i, ID_TASK_UNIT, TASK_UNIT_PRE_ENQ_BUF,
+        pci_config(i, ID_L2_RW, L2_CIRCULATE_ON_STALL  , 1);
+        pci_config(i, ID_L2_RO, L2_CIRCULATE_ON_STALL  , 1);
+        pci_config(i, ID_L2_RW, L2_PREFETCH_CAPACITY, prefetch_capacity);
+        pci_config(i, ID_L2_RO, L2_PREFETCH_CAPACITY, prefetch_capacity);
+        if (prefetch_config) {
+            pci_config(i, ID_RW_READ, PREFETCHER_BASE_ADDR, prefetch_base);
+            pci_config(i, ID_RW_READ, PREFETCHER_OBJECT_SIZE, prefetch_log_size);
+        }
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_SPILL_THRESHOLD, spill_threshold);
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_CLEAN_THRESHOLD, clean_threshold);
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_TIED_CAPACITY, tied_cap);
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_SPILL_SIZE, spill_size);
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_SPILL_CHECK_LIMIT, spill_size * 16);
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_ALT_DEBUG, 0); // get enq args instead of deq object/ts
+
+        pci_config(i, ID_TASK_UNIT, TASK_UNIT_PRE_ENQ_BUF,
                 (pre_enq_fifo_thresh << 16) | deq_tolerance);
         // Do not dequeue a task with a timestamp larger by this much than the gvt
         if (NO_ROLLBACK) {
-            // astar - 900
-            // sssp - 5000
-            uint32_t throttle_margin = (app == APP_ASTAR) ? 900 : 5000;
-            pci_poke(i, ID_TASK_UNIT, TASK_UNIT_THROTTLE_MARGIN, throttle_margin);
+            pci_config(i, ID_TASK_UNIT, TASK_UNIT_THROTTLE_MARGIN, throttle_margin);
         }
 
         if (app == APP_MAXFLOW) {
-            pci_poke(i, ID_TASK_UNIT, TASK_UNIT_IS_TRANSACTIONAL, 1);
-            pci_poke(i, ID_TASK_UNIT, TASK_UNIT_GLOBAL_RELABEL_START_MASK, (1<<headers[10]) - 1);
-            pci_poke(i, ID_TASK_UNIT, TASK_UNIT_GLOBAL_RELABEL_START_INC, 16);
-            pci_poke(i, ID_CQ, CQ_IGNORE_GVT_TB, 1);
+            pci_config(i, ID_TASK_UNIT, TASK_UNIT_IS_TRANSACTIONAL, 1);
+            pci_config(i, ID_TASK_UNIT, TASK_UNIT_GLOBAL_RELABEL_START_MASK, (1<<headers[10]) - 1);
+            pci_config(i, ID_TASK_UNIT, TASK_UNIT_GLOBAL_RELABEL_START_INC, 16);
+            pci_config(i, ID_CQ, CQ_IGNORE_GVT_TB, 1);
         }
 
-        if (app == APP_COLOR) {
-            pci_poke(i, ID_TASK_UNIT, TASK_UNIT_PRODUCER_THRESHOLD, 100);
+        if (param_valid(PARAM_PRODUCER_THRESHOLD)) {
+            pci_config(i, ID_TASK_UNIT, TASK_UNIT_PRODUCER_THRESHOLD,
+                    param(PARAM_PRODUCER_THRESHOLD));
         }
-        pci_poke(i, ID_OCL_SLAVE, OCL_ACCESS_MEM_SET_MSB, 0 );
+        pci_config(i, ID_OCL_SLAVE, OCL_ACCESS_MEM_SET_MSB, 0 );
+    }
+    if (pci_batch_end()) exit(1);
+    if (resident != NULL) {
+        printf("Config: %d of %d register writes unchanged, skipped\n",
+                pci_config_skipped, pci_config_writes);
     }
     usleep(20);
     pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &startCycle);
@@ -754,7 +982,27 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
     if (endCycle == startCycle) return -1; // OCL_BUS is broken -> abort!!
 
+    uint32_t core_mask = 0;
+    uint32_t active_cores = N_CORES;
+    if (!USING_PIPELINED_TEMPLATE & active_threads > 0) active_cores = active_threads;
+    core_mask = (1<<(active_cores))-1;
+    if (!USING_PIPELINED_TEMPLATE) core_mask <<= 16;
+    core_mask |= (1<<ID_COALESCER);
+    core_mask |= (1<<ID_SPLITTER);
+    printf("mask %x\n", core_mask);
+
+    if (query_file != NULL) {
+        // Stages 4-8 once per query instead, see query.c
+        rc = run_queries(query_file, query_out_file, app, &input, active_tiles,
+                core_mask);
+        unload_input(&input);
+        dma_close();
+        stage_end();
+        return rc;
+    }
+
     // Stage 4 : Application-specific initialization
+    stage_begin("initial_enqueue");
 
     pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_TTYPE, 0 );
     pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARG_WORD, 0 );
@@ -763,6 +1011,19 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     switch (app) {
         case APP_DES:
             printf("APP_DES\n");
+            if (bulk_enq) {
+                task_fmt_t fmt = { 4, USING_PIPELINED_TEMPLATE ? 32 : 16 };
+                init_task_t* tasks = (init_task_t*) calloc(headers[11], sizeof(init_task_t));
+                for (int i=0;i<headers[11];i++) { // numI
+                    tasks[i].ttype = 1;
+                    tasks[i].object = ((uint32_t*) write_buffer)[headers[7] + i];
+                }
+                rc = bulk_enqueue(tasks, headers[11], &fmt, active_tiles, true);
+                free(tasks);
+                if (rc == 0) break;
+                printf("Falling back to OCL enqueues\n");
+            }
+            pci_batch_begin();
             for (int i=0;i<N_TILES;i++) {
                 pci_poke(i, 0, OCL_TASK_ENQ_TTYPE,  1);
             }
@@ -773,7 +1034,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                     (*(ref_ptr + 2)<<16) +
                     (*(ref_ptr + 1)<<8)  +
                     *ref_ptr;
-                uint32_t enq_tile = (enq_object>>4) %(active_tiles);
+                uint32_t enq_tile = tsb_tile(enq_object, active_tiles, true);
                 pci_poke(enq_tile, ID_OCL_SLAVE, OCL_TASK_ENQ_OBJECT , enq_object );
                 pci_poke(enq_tile, ID_OCL_SLAVE, OCL_TASK_ENQ_ARGS , 0 );
                 //usleep(10);
@@ -781,6 +1042,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
                 printf("Enquing initial task %d\n", enq_object);
             }
+            if (pci_batch_end()) exit(1);
             break;
         case APP_SSSP:
             printf("APP_SSSP\n");
@@ -836,6 +1098,21 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
             break;
         case APP_RBP:
             printf("APP_RBP\n");
+            if (bulk_enq) {
+                // Messages 2k and 2k+1 are the two directions of edge k
+                task_fmt_t fmt = { 8, 128 };
+                size_t n_msgs = 2 * (size_t) headers[2];
+                init_task_t* tasks = (init_task_t*) calloc(n_msgs, sizeof(init_task_t));
+                for (size_t i = 0; i < n_msgs; i++) {
+                    tasks[i].object = i;
+                    tasks[i].args[0] = i ^ 1;
+                }
+                rc = bulk_enqueue(tasks, n_msgs, &fmt, active_tiles, true);
+                free(tasks);
+                if (rc == 0) break;
+                printf("Falling back to OCL enqueues\n");
+            }
+            pci_batch_begin();
             for (int i = 0; i < (2 * headers[2]); i += 2) {
                 pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARG_WORD, 0 );
                 pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ_ARGS , i+1 );
@@ -857,7 +1134,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
                 pci_poke(0, ID_OCL_SLAVE, OCL_TASK_ENQ, 0 );
             }
-
+            if (pci_batch_end()) exit(1);
 
             break;
 
@@ -865,6 +1142,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     printf("Starting Applicaton\n");
 
     // Stage 5: Start Application
+    stage_begin("run");
 
     for (int i=0;i<N_TILES;i++) {
         // Number of remaining dequues
@@ -876,21 +1154,30 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     printf("PCI latency %d cycles\n", endCycle - startCycle);
     if (endCycle == startCycle) return -1;
 
-    if (logging_on) {
+    if (logging_on && log_async) {
+        // Drain the logs in the background while the cores run unthrottled
+        log_source_t sources[8];
+        uint32_t n_sources = 0;
+        sources[n_sources++] = (log_source_t) {LOG_DDR, (N_TILES << 8) | ID_GLOBAL, fwddr};
+        sources[n_sources++] = (log_source_t) {LOG_TASK_UNIT, ID_TASK_UNIT, fwtu};
+        if (APP_ID == RISCV_ID) {
+            sources[n_sources++] = (log_source_t) {LOG_RISCV, 16, fwrv_0};
+        } else if (USING_PIPELINED_TEMPLATE) {
+            sources[n_sources++] = (log_source_t) {LOG_RO_STAGE, ID_RO_STAGE, fwro};
+            sources[n_sources++] = (log_source_t) {LOG_RW_STAGE, ID_RW_READ, fwrw};
+        }
+        sources[n_sources++] = (log_source_t) {LOG_CACHE, ID_L2_RW, fwl2};
+        sources[n_sources++] = (log_source_t) {LOG_CACHE, ID_L2_RO, fwl2ro};
+        sources[n_sources++] = (log_source_t) {LOG_CQ, ID_CQ, fwcq};
+        sources[n_sources++] = (log_source_t) {LOG_SERIALIZER, ID_SERIALIZER, fwser};
+        if (log_stream_start(read_fd, sources, n_sources, log_watermark)) exit(1);
+    } else if (logging_on) {
         // If we are in debugging mode, only allow a small number of tasks at a
         // time, lest the on-chip buffers fill up.
         for (int i=0;i<N_TILES;i++) {
             pci_poke(i, ID_ALL_APP_CORES, CORE_N_DEQUEUES , logging_phase_tasks);
         }
     }
-    uint32_t core_mask = 0;
-    uint32_t active_cores = N_CORES;
-    if (!USING_PIPELINED_TEMPLATE & active_threads > 0) active_cores = active_threads;
-    core_mask = (1<<(active_cores))-1;
-    if (!USING_PIPELINED_TEMPLATE) core_mask <<= 16;
-    core_mask |= (1<<ID_COALESCER);
-    core_mask |= (1<<ID_SPLITTER);
-    printf("mask %x\n", core_mask);
     uint64_t startCycle64 = 0;
     uint64_t endCycle64 = 0;
     pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &startCycle);
@@ -902,19 +1189,31 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
         pci_poke(i, ID_ALL_CORES, CORE_START, core_mask);
     }
 
+    if (telemetry_file != NULL) {
+        if (telemetry_start(telemetry_file, telemetry_regs, telemetry_us,
+                    active_tiles)) exit(1);
+    }
+    if (ctrl_on) {
+        // Tasks beyond the threads that can run them are not limited anyway
+        uint32_t running_cap = USING_PIPELINED_TEMPLATE ?
+            ((active_threads > 0) ? active_threads : 16) : active_cores;
+        if (max_threads < running_cap) running_cap = max_threads;
+        if (controller_start(ctrl_log_file, active_tiles, ctrl_ms, ctrl_target,
+                    throttle_margin, running_cap, running_cap)) exit(1);
+    }
+
     usleep(2);
 
     printf("Waiting until app completes\n");
 
     // Stage 6: Wait until Application completes
 
-    ocl_data = 0;
    uint32_t* results;
 
     int iters = 0;
 
-   time_t t1,t2;
-   t1 = time(NULL);
+   uint64_t t1 = timer_ns();
+   uint64_t t2 = t1;
    while(true) {
        uint32_t gvt;
        if (NO_ROLLBACK) {
@@ -936,7 +1235,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                // Hence sample a few times before terminating
                for (int i=0;i<64;i++) {
                    usleep(1);
-                   if (logging_on) {
+                   if (logging_on && !log_async) {
                        pci_poke(0, ID_ALL_APP_CORES, CORE_N_DEQUEUES, logging_phase_tasks);
                    }
                    pci_peek(i%active_tiles, ID_OCL_SLAVE, OCL_DONE, (uint32_t*) &gvt);
@@ -945,7 +1244,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
            }
            if (done) break;
        }
-       if (logging_on) {
+       if (logging_on && !log_async) {
 
            log_ddr(pci_bar_handle, read_fd, fwddr, log_buffer, (N_TILES << 8) | ID_GLOBAL);
            //log_axi(pci_bar_handle, read_fd, fwrw, log_buffer, ID_UNDO_LOG+1);
@@ -976,21 +1275,39 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
        //loop_debuggin_no_rollback(iters);
        usleep(1000);
        iters++;
-       t2 = time(NULL);
-       double time_s = (double)(t2-t1);
-       if (time_s > 30) exit(0);
+       t2 = timer_ns();
+       double time_s = (t2 - t1) / 1e9;
+       if (time_s > 30) {
+           controller_stop();
+           telemetry_stop();
+           log_stream_stop();
+           exit(1);
+       }
 
    }
-       double time_s = (double) (t2-t1) ;
+   stage_begin("stop");
+   if (clock_mhz == 0) {
+       clock_mhz = fpga_clock_mhz();
+       if (clock_mhz == 0) {
+           printf("FPGA cycle counter is not running, assuming 125 MHz\n");
+           clock_mhz = 125;
+       }
+   }
+   printf("FPGA clock %.3f MHz\n", clock_mhz);
+   controller_stop();
+   telemetry_stop();
+   double time_s = (t2 - t1) / 1e9;
    printf("time_s %f\n", time_s);
    // disable new dequeues from cores; for accurate counting of no tasks stalls
    pci_poke(0, ID_ALL_APP_CORES, CORE_N_DEQUEUES ,0x0);
    for (int i=0;i<N_TILES;i++) {
        pci_poke(i, ID_ALL_CORES, CORE_START, 0);
    }
-   usleep(2800);
-   usleep(300000);
-   if (logging_on) {
+   // let the tasks in flight drain
+   stat_wait_quiet(active_tiles, 300000);
+   if (logging_on && log_async) {
+       log_stream_stop();
+   } else if (logging_on) {
        log_ddr(pci_bar_handle, read_fd, fwddr, log_buffer,
                    (N_TILES << 8) | ID_GLOBAL);
        log_task_unit(pci_bar_handle, read_fd, fwtu, log_buffer, ID_TASK_UNIT);
@@ -1011,6 +1328,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
    }
 
    fflush(fwtu);
+   stage_begin("counters");
    printf("iters %d\n", iters);
    cycles = endCycle64 - startCycle64;
    //core_stats(0, cycles);
@@ -1021,15 +1339,21 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
        }
    }
 
-   printf("Completed, flushing cache..\n");
-   for (int i=0;i<N_TILES;i++) {
-      pci_poke(i, ID_L2_RW, L2_FLUSH , 1 );
-      usleep(100000);
-      pci_poke(i, ID_L2_RO, L2_FLUSH , 1 );
-      usleep(100000);
+   if (stats_json_file != NULL) {
+       // before the flush, which adds to the L2 eviction counts
+       stat_snapshot_t snap;
+       stat_snapshot(&snap, active_tiles);
+       stat_write_json(stats_json_file, &snap, cycles, app_names[app]);
+       stat_snapshot_free(&snap);
    }
 
+   stage_begin("cache_flush");
+   printf("Completed, flushing cache..\n");
+   // before the L2 counters are read, which include the flush evictions
+   l2_flush(N_TILES, 1000000);
+
    // Stage 7: Application completed. Read counters for analysis.
+   stage_begin("counters");
 
    if (!NO_ROLLBACK) {
        cq_stats(0, cycles);
@@ -1078,6 +1402,12 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                printf("\tretry:  stall:%9d, not_empty:%9d, count:%9d\n",
                        retry_stall, retry_not_empty, retry_count);
                printf("\tstall_in     :%9d\n", stall_in);
+               if (prefetch_capacity > 0) {
+                   uint32_t pf_hits, pf_misses;
+                   pci_peek(t, ID_L2_RW+b, L2_PREFETCH_HITS ,  &pf_hits);
+                   pci_peek(t, ID_L2_RW+b, L2_PREFETCH_MISSES ,  &pf_misses);
+                   printf("\tprefetch hits:%9d misses:%9d\n", pf_hits, pf_misses);
+               }
            }
 
            sum_l2_read_hit += l2_read_hits;
@@ -1090,7 +1420,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
    printf("Task Unit Ops %d, num_edges %d\n", task_unit_ops, numE);
 
 
-   double time_ms = (cycles + 0.0) * 8/1e6;
+   double time_ms = cycles / (clock_mhz * 1e3);
    double read_bandwidth_MBPS = (sum_l2_read_miss + sum_l2_write_miss) * 64 / (time_ms * 1000) ;
    double write_bandwidth_MBPS = (sum_l2_evictions) * 64 / (time_ms * 1000) ;
 
@@ -1120,21 +1450,9 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
     // Stage 8: application specific verification
 
    printf("Flush completed, reading results..\n");
-   ocl_data = 1;
-   uint32_t iter=0;
-   while(ocl_data==1) {
-       if (iter++ > 10) {
-           printf("Flush did not complete.. Reading anyway\n");
-           break;
-       }
-       for (int i=0;i<N_TILES;i++) {
-           pci_peek(i, ID_L2_RW, L2_FLUSH, &ocl_data);
-           if (ocl_data == 1) break;
-           usleep(1000);
-       }
-   }
        log_ddr(pci_bar_handle, read_fd, fwddr, log_buffer,
                    (N_TILES << 8) | ID_GLOBAL);
+   log_raw_close();
 
 
    pci_poke(0, ID_OCL_SLAVE, OCL_ACCESS_MEM_SET_MSB        , 0 );
@@ -1144,11 +1462,43 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
 
    FILE* mf_state = fopen("maxflow_state", "w");
    FILE* fastar = fopen("astar_verif", "w");
+   // Results are streamed back over all C2H channels; each verifier consumes
+   // chunks as they arrive. Verifiers that look at neighbours read in place
+   // and only process a vertex once everything it refers to has arrived.
+   // The time spent waiting for chunks is charged to readback, the rest to
+   // verification.
+   stage_begin("verify");
+   dma_reader_t* reader;
+   dma_chunk_t chunk;
+   bool read_done;
+   uint32_t next_vid;
+   dma_stats_reset();
    switch (app) {
        case APP_DES:
            results = (uint32_t*) malloc(4*(numV+16));
-           for (int i=0;i<numV/16 +1;i++){
-               fpga_dma_burst_read(read_fd, (uint8_t*) (results + i*16), 16*4, 64 + i*64);
+           FILE* fdes = fopen("des_debug", "w");
+           reader = dma_read_start((unsigned char*) results, (numV/16 + 1)*64, 64);
+           while (dma_read_next(reader, &chunk)) {
+               uint32_t first = chunk.offset / 4;
+               uint32_t last = (chunk.offset + chunk.len) / 4;
+               if (last > numV) last = numV;
+               for (int i=first;i<last;i++) {
+                   uint32_t act_data = results[i];
+                   uint32_t outVal = act_data >> 24 & 0x3;
+                   uint32_t in0 = (act_data >> 22) & 0x3 ;
+                   uint32_t in1 = (act_data >> 20) & 0x3 ;
+                   uint32_t type = (act_data >> 16) & 0x7 ;
+                   uint32_t delay = (act_data ) & 0xffff ;
+                   fprintf(fdes, "[%3d] outVal: %d in0: %d in1: %d type: %d delay: %4d\n",
+                           i, outVal, in0, in1, type, delay
+                          );
+               }
+               dma_read_release(reader, &chunk);
+           }
+           fclose(fdes);
+           if (dma_read_finish(reader)) {
+               printf("Result readback failed\n");
+               readback_failed = true;
            }
            for (int i=0;i<headers[12];i++) {  // numOutputs
                unsigned char* ref_ptr = write_buffer + (headers[6] +i)*4;
@@ -1169,27 +1519,16 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                            !error ? "MATCH" : "FAIL", num_errors, headers[12] );
                }
            }
-           FILE* fdes = fopen("des_debug", "w");
-           for (int i=0;i<numV;i++) {
-               uint32_t act_data = results[i];
-               uint32_t outVal = act_data >> 24 & 0x3;
-               uint32_t in0 = (act_data >> 22) & 0x3 ;
-               uint32_t in1 = (act_data >> 20) & 0x3 ;
-               uint32_t type = (act_data >> 16) & 0x7 ;
-               uint32_t delay = (act_data ) & 0xffff ;
-               fprintf(fdes, "[%3d] outVal: %d in0: %d in1: %d type: %d delay: %4d\n",
-                       i, outVal, in0, in1, type, delay
-                      );
-           }
-           fclose(fdes);
            break;
        case APP_SSSP:
        case APP_ASTAR:
-           results = (uint32_t*) malloc(4*(numV+16));
-           for (int i=0;i<numV/16 +1;i++){
-               fpga_dma_burst_read(read_fd, (uint8_t*) (results + i*16), 16*4, 64 + i*64);
-           }
-           for (int i=0;i<numV;i++) {
+           reader = dma_read_start(NULL, (numV/16 + 1)*64, 64);
+           while (dma_read_next(reader, &chunk)) {
+           results = (uint32_t*) chunk.data;
+           uint32_t first = chunk.offset / 4;
+           uint32_t last = (chunk.offset + chunk.len) / 4;
+           if (last > numV) last = numV;
+           for (int i=first;i<last;i++) {
                int ref_ptr_loc = (app != APP_ASTAR) ? 6 : 9;
                unsigned char* ref_ptr = write_buffer + (headers[ref_ptr_loc] +i)*4;
                //printf("%d\n", *(ref_ptr+1));
@@ -1207,7 +1546,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                    pci_poke(0, ID_OCL_SLAVE, OCL_ACCESS_MEM_SET_MSB        , msb );
                }
                uint32_t act_dist;
-               act_dist = results[i];
+               act_dist = results[i - first];
                bool error;
                if (app == APP_ASTAR)
                    error = abs(act_dist - ref_dist) >5;
@@ -1239,6 +1578,12 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                    }
                }
            }
+           dma_read_release(reader, &chunk);
+           }
+           if (dma_read_finish(reader)) {
+               printf("Result readback failed\n");
+               readback_failed = true;
+           }
            printf("Total Errors %d / %d\n", num_errors, ref_count);
            if (num_errors > 0) {
                printf("Earliest Fail %d (%x) / %d\n",
@@ -1263,18 +1608,38 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
            break;
        case APP_COLOR:
            results = (uint32_t*) malloc(16*(numV+100));
-           for (int i=0;i<numV/16 + 1;i++){
-               fpga_dma_burst_read(read_fd, (uint8_t*) (results + i*16*4),
-                       16*16, 64 + i*16*16);
-           }
            color_node_prop_t* c_nodes =
                (color_node_prop_t *) (results);// (write_buffer + headers[5]*4);
            // verification
 
            FILE* fc = fopen("color_verif", "w");
-           for (int i=0;i<numV;i++) {
+           reader = dma_read_start((unsigned char*) results, (numV/16 + 1)*256, 64);
+           read_done = false;
+           next_vid = 0;
+           while (!read_done) {
+           uint32_t avail = numV;
+           if (dma_read_next(reader, &chunk)) {
+               dma_read_release(reader, &chunk);
+               avail = (chunk.offset + chunk.len) / sizeof(color_node_prop_t);
+           } else {
+               read_done = true;
+               // the last sweep covers the whole buffer, so it has to be in
+               if (dma_read_finish(reader)) {
+                   printf("Result readback failed\n");
+                   readback_failed = true;
+                   break;
+               }
+           }
+           for (;next_vid<numV;next_vid++) {
+               int i = next_vid;
+               if (i >= avail) break;
                uint32_t eo_begin =c_nodes[i].eo_begin;
                uint32_t eo_end =eo_begin + c_nodes[i].degree;
+               bool ready = true;
+               for (int j=eo_begin;j<eo_end;j++) {
+                    if (csr_neighbors[j] >= avail) ready = false;
+               }
+               if (!ready) break;
                uint32_t i_deg = eo_end - eo_begin;
                uint32_t i_color = c_nodes[i].color;
 
@@ -1305,20 +1670,41 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                    printf("Error at vid:%3d color:%5d\n",
                            i, c_nodes[i].color);
 
+           }
            }
            printf("Total Errors %d / %d\n", num_errors, numV);
            break;
       case APP_MAXFLOW:
            results = (uint32_t*) malloc(64*(numV+100));
-           for (int i=0;i<numV/16 + 1;i++){
-               fpga_dma_burst_read(read_fd, (uint8_t*) (results + i*16*16),
-                       16*64, 64 + i*64*16);
-           }
            maxflow_edge_prop_t* edges =
                (maxflow_edge_prop_t *) (write_buffer + headers[4]*4);
            maxflow_node_prop_t* nodes =
                (maxflow_node_prop_t *) (results);// (write_buffer + headers[5]*4);
-           for (int i=0;i <numV;i++) {
+           reader = dma_read_start((unsigned char*) results, (numV/16 + 1)*1024, 64);
+           read_done = false;
+           next_vid = 0;
+           while (!read_done) {
+           uint32_t avail = numV;
+           if (dma_read_next(reader, &chunk)) {
+               dma_read_release(reader, &chunk);
+               avail = (chunk.offset + chunk.len) / sizeof(maxflow_node_prop_t);
+           } else {
+               read_done = true;
+               // the last sweep covers the whole buffer, so it has to be in
+               if (dma_read_finish(reader)) {
+                   printf("Result readback failed\n");
+                   readback_failed = true;
+                   break;
+               }
+           }
+           for (;next_vid<numV;next_vid++) {
+               int i = next_vid;
+               if (i >= avail) break;
+               bool ready = true;
+               for (int j=csr_offset[i];j<csr_offset[i+1];j++) {
+                    if ((edges[j].dest & 0xffffff) >= avail) ready = false;
+               }
+               if (!ready) break;
                fprintf(mf_state, "node:%3d excess:%3d height:%3d %s\n",
                        i, nodes[i].excess, nodes[i].height,
                        (nodes[i].excess>0)?"inflow" : "");
@@ -1342,6 +1728,7 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
                fprintf(mf_state, "\tsum_flow:%d %s\n",
                        sum_flow, sum_flow != 0 ? "WHAT?" : "");
 
+           }
            }
            printf("node:%3d excess:%3d height:%3d\n", headers[9], nodes[headers[9]].excess, nodes[headers[9]].height);
            fflush(mf_state);
@@ -1351,49 +1738,71 @@ int test_chronos(int slot_id, int pf_id, int bar_id, FILE* fg, int app) {
            FILE* fref = fopen("../../riscv_code/silo/silo_ref", "rb");
            fseek (fref , 0 , SEEK_END);
            long lSizeRef = ftell (fref);
-           printf("File %p size %ld\n", fg, lSizeRef);
+           printf("File %p size %ld\n", fref, lSizeRef);
            rewind (fref);
            uint32_t* ref = (uint32_t *) malloc(lSizeRef);
            fread( (void*) ref, 1, lSizeRef, fref);
 
-           results = (uint32_t*) malloc(lSizeRef + 100);
-           for (int i=0;i<lSizeRef/1024 + 1;i++){
-               fpga_dma_burst_read(read_fd, (uint8_t*) (results + i*16*16),
-                       16*64, i*64*16);
-           }
-           for (int i=0;i<lSizeRef/4;i++) {
+           reader = dma_read_start(NULL, (lSizeRef/1024 + 1)*1024, 0);
+           while (dma_read_next(reader, &chunk)) {
+           results = (uint32_t*) chunk.data;
+           uint32_t first = chunk.offset / 4;
+           uint32_t last = (chunk.offset + chunk.len) / 4;
+           if (last > lSizeRef/4) last = lSizeRef/4;
+           for (int i=first;i<last;i++) {
 
-                if (results[i] != ref[i]){
+                if (results[i - first] != ref[i]){
                     num_errors++;
                     if (num_errors < 100) {
                         printf("mismatch on word %8x (addr %8x); ref: %8x act: %8x\n", i, i*4,
-                                results[i], ref[i]);
+                                results[i - first], ref[i]);
                     }
                 }
            }
+           dma_read_release(reader, &chunk);
+           }
+           if (dma_read_finish(reader)) {
+               printf("Result readback failed\n");
+               readback_failed = true;
+           }
            printf("Verification complete. %d/%d errors\n", num_errors, lSizeRef/4);
            break;
         case APP_RBP:
            printf("RBP verification\n");
-           results = (uint32_t*) malloc(16*(numE+16));
-           for (int i=0;i<numE;i++){
-               fpga_dma_burst_read(read_fd, (uint8_t*) (results + i*16), 16, headers[11]*4 + i*16);
+           // Two messages of two floats per edge
+           reader = dma_read_start(NULL, (size_t) numE*16, headers[11]*4);
+           while (dma_read_next(reader, &chunk)) {
+               float* msg = (float*) chunk.data;
+               uint32_t first = chunk.offset / 8;
+               uint32_t last = (chunk.offset + chunk.len) / 8;
+               for (int i=first;i<last;i++) {
+                   printf("message %d: (%f, %f)\n", i, msg[(i-first)*2], msg[(i-first)*2 + 1]);
+               }
+               dma_read_release(reader, &chunk);
            }
-           for (int i=0;i<numE*2;i++) {
-               printf("message %d: (%f, %f)\n", i, *((float *) (&results[i*2])), *((float *) (&results[i*2 + 1])));
+           if (dma_read_finish(reader)) {
+               printf("Result readback failed\n");
+               readback_failed = true;
            }
 
            break;
 
    }
 
-   if (write_buffer != NULL) {
-       free(write_buffer);
-   }
+   stage_move("verify", "readback", dma_read_wait_ns());
+   dma_stats("Read results");
+   unload_input(&input);
+   dma_close();
    if (read_buffer != NULL) {
        free(read_buffer);
    }
-   return 0;
+   stage_end();
+   stage_print(cycles, clock_mhz);
+   if (timing_json_file != NULL) {
+       stage_write_json(timing_json_file, app_names[app], cycles, clock_mhz);
+   }
+   // non-zero so that daemon clients see verification failures
+   return (num_errors > 0 || readback_failed) ? 1 : 0;
 }
 
 
@@ -0,0 +1,179 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Wall-clock stage timers for test_chronos.
+//
+// The host side of a run is split into named stages. stage_begin() ends the
+// current stage and starts the next, so consecutive stages cover the run
+// without gaps; a stage that is entered more than once accumulates. Times are
+// taken from CLOCK_MONOTONIC. stage_print() prints the breakdown and
+// stage_write_json() writes it, together with the FPGA-side run time, for
+// --timing_json=<file>.
+//
+// fpga_clock_mhz() measures the FPGA clock by reading OCL_CUR_CYCLE at both
+// ends of an interval of host time, so that cycle counts can be converted to
+// time without assuming the clock the image was built for.
+
+#include "header.h"
+
+#include <time.h>
+
+#define STAGE_MAX 32
+
+static struct {
+    const char* name[STAGE_MAX];
+    uint64_t ns[STAGE_MAX];
+    uint32_t n;
+    int cur;              // -1 if no stage is running
+    uint64_t cur_start;
+} stages = { .cur = -1 };
+
+uint64_t timer_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int stage_lookup(const char* name) {
+    for (uint32_t i=0;i<stages.n;i++) {
+        if (strcmp(stages.name[i], name) == 0) return i;
+    }
+    if (stages.n == STAGE_MAX) return -1;
+    stages.name[stages.n] = name;
+    stages.ns[stages.n] = 0;
+    return stages.n++;
+}
+
+// name must outlive the timers; stages are reported in the order they were
+// first entered.
+void stage_begin(const char* name) {
+    uint64_t now = timer_ns();
+    if (stages.cur >= 0) stages.ns[stages.cur] += now - stages.cur_start;
+    stages.cur = stage_lookup(name);
+    stages.cur_start = now;
+}
+
+void stage_end() {
+    if (stages.cur < 0) return;
+    stages.ns[stages.cur] += timer_ns() - stages.cur_start;
+    stages.cur = -1;
+}
+
+// Moves ns of the time charged to one stage to another, for stages that are
+// interleaved in the code (e.g. readback and verification).
+void stage_move(const char* from, const char* to, uint64_t ns) {
+    if (stages.cur >= 0) {
+        // bring the running stage up to date
+        uint64_t now = timer_ns();
+        stages.ns[stages.cur] += now - stages.cur_start;
+        stages.cur_start = now;
+    }
+    int f = stage_lookup(from);
+    int t = stage_lookup(to);
+    if (f < 0 || t < 0) return;
+    if (ns > stages.ns[f]) ns = stages.ns[f];
+    stages.ns[f] -= ns;
+    stages.ns[t] += ns;
+}
+
+static uint64_t stage_total_ns() {
+    uint64_t total = 0;
+    for (uint32_t i=0;i<stages.n;i++) total += stages.ns[i];
+    return total;
+}
+
+// cycles is the FPGA run, shown next to the host-side stages.
+void stage_print(uint64_t cycles, double clock_mhz) {
+    uint64_t total = stage_total_ns();
+    printf("Stage times (host wall clock):\n");
+    for (uint32_t i=0;i<stages.n;i++) {
+        printf("\t%-16s %10.3f ms %6.2f%%\n", stages.name[i], stages.ns[i] / 1e6,
+                total ? stages.ns[i] * 100.0 / total : 0.0);
+    }
+    printf("\t%-16s %10.3f ms\n", "total", total / 1e6);
+    if (clock_mhz > 0) {
+        printf("\t%-16s %10.3f ms (%lu cycles at %.3f MHz)\n", "fpga run",
+                cycles / (clock_mhz * 1e3), cycles, clock_mhz);
+    }
+}
+
+int stage_write_json(const char* path, const char* app, uint64_t cycles,
+        double clock_mhz) {
+    FILE* fw = fopen(path, "w");
+    if (fw == NULL) {
+        printf("Unable to open %s\n", path);
+        return 1;
+    }
+    uint64_t total = stage_total_ns();
+    fprintf(fw, "{\n");
+    fprintf(fw, "  \"app\": \"%s\",\n", app);
+    fprintf(fw, "  \"clock_mhz\": %.6f,\n", clock_mhz);
+    fprintf(fw, "  \"fpga_cycles\": %lu,\n", cycles);
+    fprintf(fw, "  \"fpga_ms\": %.6f,\n", clock_mhz > 0 ? cycles / (clock_mhz * 1e3) : 0.0);
+    fprintf(fw, "  \"total_ms\": %.6f,\n", total / 1e6);
+    fprintf(fw, "  \"stages\": [\n");
+    for (uint32_t i=0;i<stages.n;i++) {
+        fprintf(fw, "    {\"name\": \"%s\", \"ms\": %.6f}%s\n", stages.name[i],
+                stages.ns[i] / 1e6, (i + 1 < stages.n) ? "," : "");
+    }
+    fprintf(fw, "  ]\n");
+    fprintf(fw, "}\n");
+    fclose(fw);
+    return 0;
+}
+
+static uint64_t fpga_cycle() {
+    uint32_t msb, lsb, msb2;
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb);
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_LSB, &lsb);
+    pci_peek(0, ID_OCL_SLAVE, OCL_CUR_CYCLE_MSB, &msb2);
+    // LSB wrapped between the reads
+    if (msb2 != msb && lsb < 0x80000000) msb = msb2;
+    return ((uint64_t) msb << 32) | lsb;
+}
+
+static uint64_t clock_cycle0, clock_ns0;
+
+// Reads the cycle counter and the host time at which it was read, taken as
+// the middle of the OCL reads.
+static uint64_t fpga_cycle_at(uint64_t* ns) {
+    uint64_t before = timer_ns();
+    uint64_t cycle = fpga_cycle();
+    *ns = before + (timer_ns() - before) / 2;
+    return cycle;
+}
+
+// Marks the start of the measuring interval; fpga_clock_mhz() ends it. The
+// interval should be long against the OCL read latency (a few us); test_chronos
+// measures from setup to the end of the run.
+void fpga_clock_start() {
+    clock_cycle0 = fpga_cycle_at(&clock_ns0);
+}
+
+// Returns 0 if the cycle counter did not advance.
+double fpga_clock_mhz() {
+    uint64_t ns;
+    uint64_t cycle = fpga_cycle_at(&ns);
+    if (cycle <= clock_cycle0 || ns <= clock_ns0) return 0;
+    return (cycle - clock_cycle0) * 1e3 / (ns - clock_ns0);
+}
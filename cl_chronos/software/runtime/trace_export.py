@@ -0,0 +1,124 @@
+import sys
+import json
+from log_events import load, Lifecycle
+
+# Converts decoded task unit and CQ logs into a Chrome JSON trace, to be opened
+# in ui.perfetto.dev or chrome://tracing. See log_events.py for the inputs and
+# how tasks are followed through them.
+#
+# Usage: python3 trace_export.py [-o trace.json] log[@tile] [log[@tile] ...]
+#
+# Each tile is a process with
+#  - a track per core, with a slice per execution of a task, from CQ
+#    start_task to finish_task (or to abort_task if aborted while running)
+#  - an async slice per task, from task_enqueue until it commits or is
+#    aborted as a child
+#  - a task queue track with overflow and abort markers, and a counter of the
+#    tasks in the task queue
+#  - flow arrows from each parent execution to its child's first execution.
+
+CYCLE_NS = 8  # 125 MHz
+TQ_TID = 1000
+
+def us(cycle):
+    return cycle * CYCLE_NS / 1000.0
+
+class Trace(Lifecycle):
+    def __init__(self):
+        Lifecycle.__init__(self)
+        self.out = []
+        self.n_tasks = {}
+
+    def task_begin(self, t, cycle):
+        self.out.append({'ph': 'b', 'pid': t.tile, 'cat': 'task', 'id': t.uid,
+            'name': t.name(), 'ts': us(cycle),
+            'args': {'ts': '%x' % t.ts, 'object': '%x' % t.obj,
+                     'tq_slot': t.slot, 'tied': int(t.tied)}})
+
+    def exec_end(self, e):
+        if e.start is None:
+            return
+        t = e.task
+        self.out.append({'ph': 'X', 'pid': t.tile, 'tid': e.core,
+            'cat': 'exec', 'name': t.name(), 'ts': us(e.start),
+            'dur': us(e.end - e.start),
+            'args': {'ts': '%x' % t.ts, 'object': '%x' % t.obj,
+                     'tq_slot': t.slot, 'cq_slot': e.cq_slot,
+                     'outcome': e.outcome,
+                     'enq_to_start_cycles': e.start - t.enq_cycle}})
+
+    def task_end(self, t, cycle, outcome):
+        self.out.append({'ph': 'e', 'pid': t.tile, 'cat': 'task',
+            'id': t.uid, 'name': t.name(), 'ts': us(cycle),
+            'args': {'outcome': outcome}})
+
+    def task_abort(self, t, e, cycle):
+        tid = TQ_TID
+        if e is not None and e.core is not None:
+            tid = e.core
+        self.out.append({'ph': 'i', 'pid': t.tile, 'tid': tid, 's': 't',
+            'name': 'abort', 'ts': us(cycle),
+            'args': {'task': t.name(), 'tq_slot': t.slot}})
+
+    def other(self, tile, cycle, kind, a):
+        if kind == 'overflow':
+            self.out.append({'ph': 'i', 'pid': tile, 'tid': TQ_TID, 's': 't',
+                'name': 'overflow', 'ts': us(cycle),
+                'args': {'tq_slot': a[0]}})
+        elif kind == 'n_tasks':
+            if self.n_tasks.get(tile) != a:
+                self.n_tasks[tile] = a
+                self.out.append({'ph': 'C', 'pid': tile, 'name': 'task queue',
+                    'ts': us(cycle), 'args': {'tasks': a[0], 'tied': a[1]}})
+
+    # Adds flows and track names
+    def flows(self):
+        n_flows = 0
+        for t in self.tasks:
+            p = t.parent
+            c = t.first_exec
+            if p is None or c is None or p.start is None or c.start is None:
+                continue
+            n_flows += 1
+            # bound to the enclosing slices on both ends; the enqueue is
+            # within the parent's execution
+            self.out.append({'ph': 's', 'pid': p.task.tile, 'tid': p.core,
+                'cat': 'child', 'name': 'child', 'id': n_flows,
+                'ts': us(t.enq_cycle)})
+            self.out.append({'ph': 'f', 'bp': 'e', 'pid': t.tile,
+                'tid': c.core, 'cat': 'child', 'name': 'child',
+                'id': n_flows, 'ts': us(c.start)})
+        for tile in sorted(self.tiles):
+            self.out.append({'ph': 'M', 'pid': tile, 'name': 'process_name',
+                'args': {'name': 'Tile %d' % tile}})
+            self.out.append({'ph': 'M', 'pid': tile, 'tid': TQ_TID,
+                'name': 'thread_name', 'args': {'name': 'task queue'}})
+        for (tile, core) in sorted(self.cores):
+            self.out.append({'ph': 'M', 'pid': tile, 'tid': core,
+                'name': 'thread_name', 'args': {'name': 'core %d' % core}})
+        return n_flows
+
+def main():
+    args = sys.argv[1:]
+    out_path = 'trace.json'
+    if len(args) >= 2 and args[0] == '-o':
+        out_path = args[1]
+        args = args[2:]
+    if len(args) == 0:
+        print("Usage: python3 trace_export.py [-o trace.json] log[@tile] ...")
+        exit(0)
+
+    trace = Trace()
+    trace.run(load(args))
+    n_flows = trace.flows()
+
+    fw = open(out_path, 'w')
+    fw.write('{"displayTimeUnit":"ns","traceEvents":[\n')
+    fw.write(',\n'.join(json.dumps(ev, separators=(',', ':'))
+                        for ev in trace.out))
+    fw.write('\n]}\n')
+    fw.close()
+    print("%s: %d tasks, %d executions, %d aborts, %d parent-child flows" %
+          (out_path, len(trace.tasks), trace.n_execs, trace.n_aborts, n_flows))
+
+main()
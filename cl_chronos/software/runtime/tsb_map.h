@@ -0,0 +1,58 @@
+/** $lic$
+ * Copyright (C) 2014-2019 by Massachusetts Institute of Technology
+ *
+ * This file is part of the Chronos FPGA Acceleration Framework.
+ *
+ * Chronos is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this framework in your research, we request that you reference
+ * the Chronos paper ("Chronos: Efficient Speculative Parallelism for
+ * Accelerators", Abeydeera and Sanchez, ASPLOS-25, March 2020), and that
+ * you send us a citation of your work.
+ *
+ * Chronos is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host-side copy of the TSB's object -> tile mapping (design/tsb.sv; the same
+// keys are in design/cq_slice.sv). Shared by bulk_enq.c and
+// tools/graph_gen, and kept SDK-free so that graph_gen can include it. Update
+// it together with the RTL.
+
+#ifndef TSB_MAP_H
+#define TSB_MAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+static const uint32_t tsb_hash_keys[16] = {
+    0x2cccc93a, 0x05c4357e, 0x95bd7e36, 0x62e721fa,
+    0x3bbc49a6, 0x2da9f278, 0xe39243ce, 0x8329b91a,
+    0x1cd8549a, 0xfe73b4f1, 0x64d611a0, 0x04a16e92,
+    0xc8c3c457, 0xecd2efd0, 0x3a2c194f, 0x3aa2ce85
+};
+
+// Tile that an object's tasks are routed to with n_tiles active tiles
+static inline uint32_t tsb_tile(uint32_t object, uint32_t n_tiles, bool use_hash) {
+    uint32_t hashed = 0;
+    if (use_hash) {
+        for (int i=0;i<16;i++) {
+            hashed |= __builtin_parity(object & tsb_hash_keys[i] & ~0xfu) << i;
+        }
+    } else {
+        hashed = (object >> 4) & 0xffff;
+    }
+    if (n_tiles <= 1) return 0;
+    if ((n_tiles & (n_tiles - 1)) == 0) return hashed & (n_tiles - 1);
+    if (n_tiles > 16) return hashed & 0xf;
+    return hashed % n_tiles;
+}
+
+#endif
@@ -0,0 +1,163 @@
+import sys
+import random
+import chronos_run
+
+# Offline tuner for the task unit, spill and enqueuer parameters of params.c.
+# Runs test_chronos on one input with randomly drawn configurations, narrows
+# them down by successive halving, and records the best one for the app and
+# input class in a tuned configuration database, to be picked up by later runs
+# with --tuned=<db>.
+#
+# Usage: python3 tune.py [--bin=./test_chronos] [--trials=16] [--eta=2]
+#            [--rungs=3] [--seed=N] [--db=tuned.cfg] [test_chronos options]
+#            app input [riscv_hex_file]
+#
+# The first run uses the defaults; its output gives the input class, the
+# params that apply to the app and the hardware limits the draws must respect
+# (the asserts in test_chronos). The defaults are one of the --trials
+# configurations. In rung r every remaining configuration has been run eta^r
+# times and is scored by its mean FPGA cycles; the best 1/eta go on to the
+# next rung. Runs that test_chronos reports as failed (non-zero exit status,
+# see chronos_run.py) score infinity.
+# The database entry for the app and class is replaced only if the new best
+# configuration is faster than the recorded one.
+
+def draw(rng, params, lim):
+    tq = 1 << lim['log_tq_size']
+    cq = 1 << lim['log_cq_size']
+    max_spill = min(504, (1 << lim['spillq_stages']) - 1)
+    while True:
+        c = {}
+        c['tied_cap'] = rng.randint(tq // 16, tq // 2)
+        c['spill_size'] = 8 * rng.randint(4, max_spill // 8)
+        c['clean_threshold'] = rng.randint(8, min(256, (1 << lim['tq_stages']) - 1))
+        c['deq_tolerance'] = rng.randint(0, 8)
+        c['pre_enq_fifo_thresh'] = rng.randint(0, 4)
+        lo = c['tied_cap'] + cq + c['spill_size'] + 1
+        if lo > tq - 16:
+            continue
+        c['spill_threshold'] = rng.randint(lo, tq - 16)
+        c['producer_threshold'] = rng.randint(25, 400)
+        c['color_chunk'] = rng.randint(16, 256)
+        c['gr_interval_bias'] = rng.randint(1, 9)
+        c['prefetch_capacity'] = rng.choice([0, 4, 8, 16, 32])
+        return dict((k, c[k]) for k in params)
+
+def run(binary, opts, config, positional):
+    cmd = [binary] + opts
+    cmd += ['--%s=%d' % kv for kv in sorted(config.items())]
+    cmd += positional
+    return chronos_run.run(cmd)
+
+def parse_kv(s):
+    return dict((k, int(v)) for (k, v) in (kv.split('=') for kv in s.split()))
+
+def fmt(config):
+    return ' '.join('%s=%d' % kv for kv in sorted(config.items()))
+
+class Candidate:
+    def __init__(self, config):
+        self.config = config
+        self.cycles = []
+
+    def score(self):
+        if len(self.cycles) == 0 or None in self.cycles:
+            return float('inf')
+        return sum(self.cycles) / float(len(self.cycles))
+
+def update_db(path, app, cls, cycles, config):
+    try:
+        lines = open(path).readlines()
+    except IOError:
+        lines = ['# app class cycles params\n']
+    entry = '%s %s %d %s\n' % (app, cls, cycles, fmt(config))
+    for (i, line) in enumerate(lines):
+        f = line.split()
+        if len(f) >= 3 and f[0] == app and f[1] == cls and not line.startswith('#'):
+            if int(f[2]) <= cycles:
+                print("%s: keeping %s %s at %s cycles" % (path, app, cls, f[2]))
+                return
+            lines[i] = entry
+            break
+    else:
+        lines.append(entry)
+    open(path, 'w').writelines(lines)
+    print("%s: %s %s -> %d cycles" % (path, app, cls, cycles))
+
+def main():
+    binary = './test_chronos'
+    n_trials = 16
+    eta = 2
+    n_rungs = 3
+    db = 'tuned.cfg'
+    seed = None
+    opts = []
+    positional = []
+    for arg in sys.argv[1:]:
+        if arg.startswith('--bin='):
+            binary = arg[6:]
+        elif arg.startswith('--trials='):
+            n_trials = int(arg[9:])
+        elif arg.startswith('--eta='):
+            eta = int(arg[6:])
+        elif arg.startswith('--rungs='):
+            n_rungs = int(arg[8:])
+        elif arg.startswith('--seed='):
+            seed = int(arg[7:])
+        elif arg.startswith('--db='):
+            db = arg[5:]
+        elif arg.startswith('--'):
+            opts.append(arg)
+        else:
+            positional.append(arg)
+    if len(positional) < 2 or eta < 2:
+        print("Usage: python3 tune.py [--bin=./test_chronos] [--trials=16] [--eta=2] "
+              "[--rungs=3] [--seed=N] [--db=tuned.cfg] [options] app input")
+        exit(0)
+    app = positional[0]
+    rng = random.Random(seed)
+
+    base = run(binary, opts, {}, positional)
+    cls = base.field(r'^input class (\S+)')
+    params = base.field(r'^params (.*)')
+    limits = base.field(r'^param limits (.*)')
+    if base.cycles is None or cls is None or params is None or limits is None:
+        print("default configuration failed:")
+        print(base.out[-2000:])
+        exit(0)
+    defaults = parse_kv(params)
+    lim = parse_kv(limits)
+    print("%s class %s: defaults %d cycles" % (app, cls, base.cycles))
+
+    first = Candidate(defaults)
+    first.cycles.append(base.cycles)
+    candidates = [first]
+    seen = set([fmt(defaults)])
+    while len(candidates) < n_trials:
+        c = draw(rng, defaults.keys(), lim)
+        if fmt(c) not in seen:
+            seen.add(fmt(c))
+            candidates.append(Candidate(c))
+
+    runs = 1
+    for rung in range(n_rungs):
+        for c in candidates:
+            while len(c.cycles) < runs:
+                c.cycles.append(run(binary, opts, c.config, positional).cycles)
+        candidates.sort(key=lambda c: c.score())
+        print("rung %d: %d configurations x %d runs, best %.0f cycles" %
+              (rung, len(candidates), runs, candidates[0].score()))
+        if len(candidates) == 1 or rung == n_rungs - 1:
+            break
+        candidates = candidates[:max(1, (len(candidates) + eta - 1) // eta)]
+        runs *= eta
+
+    best = candidates[0]
+    if best.score() == float('inf'):
+        print("no configuration completed")
+        exit(0)
+    print("best (%.0f cycles, defaults %.0f): %s" %
+          (best.score(), first.score(), fmt(best.config)))
+    update_db(db, app, cls, int(best.score()), best.config)
+
+main()
@@ -42,11 +42,18 @@
 #include <random>
 #include <numeric>
 
-struct Node {
-   uint32_t vid;
-   uint32_t dist;
-   uint32_t bucket;
-};
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../../software/runtime/tsb_map.h"
 
 struct NodeSort {
    uint32_t vid;
@@ -66,7 +73,9 @@ struct degree_sort {
 #define APP_SSSP 0
 #define APP_COLOR 1
 #define APP_MAXFLOW 2
+#define APP_ASTAR 3
 const double EarthRadius_cm = 637100000.0;
+const double EarthRadius_m = 6371000.0; // astar weights, as in the hardware
 
 struct Vertex;
 
@@ -93,6 +102,10 @@ uint32_t* csr_offset;
 Adj* csr_neighbors;
 uint32_t* csr_dist;
 
+// --stream[=MB]: build the output out-of-core (see BuildStreamGR).
+// Budget for the dirty part of the output mapping; 0 disables streaming.
+uint64_t stream_mem_bytes = 0;
+
 void addEdge(uint32_t from, uint32_t to, uint32_t cap) {
     bool combine_edges = true;
     if (combine_edges) {
@@ -127,74 +140,284 @@ uint64_t dist(const Vertex* src, const Vertex* dst) {
    return d_cm;
 }
 
-void LoadGraphGR(const char* file) {
-   // DIMACS
-   std::ifstream f;
-   std::string s;
-   f.open(file, std::ios::binary);
-   if (!f.is_open()) {
-      printf("ERROR: Could not open input file\n");
-      exit(1);
+// Text graph inputs (DIMACS .gr, Matrix Market .mtx, SNAP/PBBS edge lists).
+//
+// The file is mmap'd and split at newline boundaries into one chunk per
+// thread. Each thread scans its chunk with a hand-written integer scanner
+// into its own edge buffer; the buffers are then merged in chunk order, so
+// every vertex sees its arcs in file order as with the old line-by-line
+// readers. Vertex IDs are kept as written until all chunks are done, since
+// for edge lists the index base is only known from the smallest ID.
+enum TextFormat { FMT_DIMACS, FMT_MTX, FMT_EDGES };
+
+struct TextEdge {
+   uint32_t src, dest, w;
+};
+
+struct TextMeta {
+   uint32_t numV = 0;        // 'p' line or MM size line, 0 if absent
+   uint32_t start = ~0u;     // DIMACS 'n <id> s'
+   uint32_t end = ~0u;       // DIMACS 'n <id> t'
+   uint32_t min_id = ~0u;
+   uint32_t max_id = 0;
+   uint64_t n_edges = 0;
+
+   void merge(const TextMeta& m) {
+      if (m.numV) numV = m.numV;
+      if (m.start != ~0u) start = m.start;
+      if (m.end != ~0u) end = m.end;
+      min_id = std::min(min_id, m.min_id);
+      max_id = std::max(max_id, m.max_id);
+      n_edges += m.n_edges;
    }
-   int n =0;
-   while(!f.eof()) {
-      std::getline(f, s);
-      if (s.c_str()[0]=='c') continue;
-      if (s.c_str()[0]=='n') {
-         char st;
-         uint32_t r;
-         sscanf(s.c_str(), "%*s %d %c\n", &r, &st);
-         if (st=='s') startNode = r-1;
-         if (st=='t') endNode = r-1;
-      }
-      if (s.c_str()[0]=='p') {
-         sscanf(s.c_str(), "%*s %*s %d %d\n", &numV, &numE);
-         graph = new Vertex[numV];
-      }
-      if (s.c_str()[0]=='a') {
-         uint32_t src, dest, w;
-         sscanf(s.c_str(), "%*s %d %d %d\n", &src, &dest, &w);
-         if (app == APP_MAXFLOW) {
-            addEdge(src-1, dest-1, w);
-         } else {
-            Adj a = {dest-1,w};
-            graph[src-1].adj.push_back(a);
-         }
-      }
+};
 
-      n++;
+struct TextGraph {
+   const char* map;
+   size_t size;
+   size_t body;              // first byte after the MM banner/size line
+   TextFormat fmt;
+   bool symmetric;           // MM 'symmetric': store both directions
+   TextMeta meta;
+};
+
+int n_threads = 0;           // --threads=N, 0 = all cores
+
+static inline const char* SkipBlank(const char* p, const char* e) {
+   while (p < e && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+   return p;
+}
+
+static inline const char* SkipWord(const char* p, const char* e) {
+   p = SkipBlank(p, e);
+   while (p < e && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+   return p;
+}
+
+static inline bool ScanU32(const char** pp, const char* e, uint32_t* v) {
+   const char* p = SkipBlank(*pp, e);
+   const char* s = p;
+   uint64_t x = 0;
+   while (p < e && (unsigned) (*p - '0') < 10) x = x * 10 + (*p++ - '0');
+   *pp = p;
+   *v = x;
+   return p != s && x <= 0xFFFFFFFFull;
+}
+
+// Edge weight: integers are scanned directly. Real or negative values
+// (weighted .mtx files) go through strtod and are rounded to |w|.
+static inline uint32_t ScanWeight(const char* p, const char* e, uint32_t dflt) {
+   p = SkipBlank(p, e);
+   uint32_t w;
+   const char* q = p;
+   if (!ScanU32(&q, e, &w)) {
+      if (q == e || *q == '\n') return dflt;
+   } else if (q == e || *q == ' ' || *q == '\t' || *q == '\r' || *q == '\n') {
+      return w;
+   }
+   char buf[64];
+   size_t n = 0;
+   while (p < e && n < sizeof(buf)-1 && *p != '\n' && *p != ' ' && *p != '\t') {
+      buf[n++] = *p++;
    }
-   printf("n %d %d %d\n",n, numV, numE);
+   buf[n] = 0;
+   return (uint32_t) round(fabs(strtod(buf, NULL)));
+}
 
+// Scan the lines of [p, e) and call on_edge(src, dest, w) with IDs as
+// written in the file.
+template <typename F>
+void ParseChunk(const TextGraph& t, const char* p, const char* e,
+      TextMeta& m, F on_edge) {
+   while (p < e) {
+      const char* eol = (const char*) memchr(p, '\n', e - p);
+      if (eol == NULL) eol = e;
+      const char* q = p;
+      uint32_t src, dest, w;
+      bool edge = false;
+      if (t.fmt == FMT_DIMACS) {
+         if (*q == 'a') {
+            q++;
+            edge = ScanU32(&q, eol, &src) && ScanU32(&q, eol, &dest);
+            w = ScanWeight(q, eol, 1);
+         } else if (*q == 'p') {
+            q = SkipWord(q+1, eol);
+            ScanU32(&q, eol, &m.numV);
+         } else if (*q == 'n') {
+            q++;
+            uint32_t r;
+            if (ScanU32(&q, eol, &r)) {
+               q = SkipBlank(q, eol);
+               if (q < eol && *q == 's') m.start = r;
+               if (q < eol && *q == 't') m.end = r;
+            }
+         }
+      } else if (*q != '%' && *q != '#' && !isalpha(*q)) {
+         // MM entries and SNAP/PBBS edge lines: "u v [w]"
+         edge = ScanU32(&q, eol, &src) && ScanU32(&q, eol, &dest);
+         w = ScanWeight(q, eol, 1);
+      }
+      if (edge) {
+         m.min_id = std::min(m.min_id, std::min(src, dest));
+         m.max_id = std::max(m.max_id, std::max(src, dest));
+         on_edge(src, dest, w);
+         m.n_edges++;
+         if (t.symmetric && src != dest) {
+            on_edge(dest, src, w);
+            m.n_edges++;
+         }
+      }
+      p = eol + 1;
+   }
 }
-void LoadGraphEdges(const char* file) {
-   std::ifstream f;
-   std::string s;
-   f.open(file, std::ios::binary);
-   if (!f.is_open()) {
+
+void OpenTextGraph(const char* file, TextGraph& t) {
+   int fd = open(file, O_RDONLY);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0) {
       printf("ERROR: Could not open input file\n");
       exit(1);
    }
-   int n =0;
-   numV = 1157828; // hack: com-youtube
-   graph = new Vertex[numV];
-   while(!f.eof()) {
-      std::getline(f, s);
-      if (s.c_str()[0]=='E') continue;
-      else {
-         uint32_t src, dest;
-         sscanf(s.c_str(), "%d %d\n", &src, &dest);
-         //printf("%d %d\n", src, dest);
-         if (src > numV || dest > numV) continue;
-         Adj a = {dest-1,0};
-         graph[src-1].adj.push_back(a);
+   t.size = st.st_size;
+   t.map = (const char*) mmap(NULL, t.size ? t.size : 1, PROT_READ,
+         MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (t.map == MAP_FAILED) {
+      printf("ERROR: Could not map input file\n");
+      exit(1);
+   }
+   madvise((void*) t.map, t.size, MADV_SEQUENTIAL);
+   t.body = 0;
+   t.symmetric = false;
+   t.meta = TextMeta();
+
+   const char* e = t.map + t.size;
+   if (t.size > 14 && strncmp(t.map, "%%MatrixMarket", 14) == 0) {
+      t.fmt = FMT_MTX;
+      const char* eol = (const char*) memchr(t.map, '\n', t.size);
+      std::string banner(t.map, eol ? eol - t.map : t.size);
+      t.symmetric = banner.find("symmetric") != std::string::npos;
+      // skip comments up to the "rows cols nnz" size line
+      const char* p = eol ? eol + 1 : e;
+      while (p < e && *p == '%') {
+         eol = (const char*) memchr(p, '\n', e - p);
+         p = eol ? eol + 1 : e;
       }
+      uint32_t rows = 0, cols = 0;
+      ScanU32(&p, e, &rows);
+      ScanU32(&p, e, &cols);
+      t.meta.numV = std::max(rows, cols);
+      eol = (const char*) memchr(p, '\n', e - p);
+      t.body = (eol ? eol + 1 : e) - t.map;
+      return;
+   }
+   // DIMACS lines start with c/p/a/n, edge lists with a digit or '#'
+   const char* p = t.map;
+   while (p < e && isspace(*p)) p++;
+   t.fmt = (p < e && strchr("cpan", *p)) ? FMT_DIMACS : FMT_EDGES;
+}
 
-      n++;
+void CloseTextGraph(TextGraph& t) {
+   munmap((void*) t.map, t.size ? t.size : 1);
+}
+
+// Serial scan of the whole body (used by the streaming builder).
+template <typename F>
+void ScanTextGraph(TextGraph& t, F on_edge) {
+   TextMeta m;
+   m.numV = t.meta.numV;
+   ParseChunk(t, t.map + t.body, t.map + t.size, m, on_edge);
+   t.meta = m;
+}
+
+// Index base of the IDs in the file: 1 for DIMACS and MM; edge lists are
+// 0-based (SNAP) unless no vertex 0 appears (e.g. com-youtube).
+uint32_t TextBase(const TextGraph& t) {
+   if (t.fmt == FMT_EDGES) return t.meta.min_id == 0 ? 0 : 1;
+   return 1;
+}
+
+// numV from the header when present, else inferred from the largest ID.
+uint32_t TextNumV(const TextGraph& t) {
+   uint32_t base = TextBase(t);
+   uint32_t inferred = t.meta.n_edges ? t.meta.max_id + 1 - base : 0;
+   if (t.meta.numV && t.meta.numV < inferred) {
+      printf("ERROR: vertex %d outside of header range %d\n",
+            t.meta.max_id, t.meta.numV);
+      exit(1);
+   }
+   return std::max(t.meta.numV, inferred);
+}
+
+void LoadGraphText(const char* file) {
+   const char* fmt_name[] = {"dimacs", "mtx", "edges"};
+   TextGraph t;
+   OpenTextGraph(file, t);
+
+   int n = n_threads ? n_threads : std::thread::hardware_concurrency();
+   if (n < 1) n = 1;
+   const char* body = t.map + t.body;
+   size_t len = t.size - t.body;
+   std::vector<const char*> split(n+1);
+   split[0] = body;
+   for (int i=1;i<n;i++) {
+      const char* p = std::max(split[i-1], body + len * i / n);
+      const char* eol = (const char*) memchr(p, '\n', body + len - p);
+      split[i] = eol ? eol + 1 : body + len;
+   }
+   split[n] = body + len;
+
+   auto start = std::chrono::steady_clock::now();
+   std::vector<std::vector<TextEdge> > parts(n);
+   std::vector<TextMeta> metas(n);
+   std::vector<std::thread> threads;
+   for (int i=0;i<n;i++) {
+      threads.emplace_back([&, i]() {
+         parts[i].reserve((split[i+1] - split[i]) / 12);
+         ParseChunk(t, split[i], split[i+1], metas[i],
+               [&](uint32_t src, uint32_t dest, uint32_t w) {
+            TextEdge e = {src, dest, w};
+            parts[i].push_back(e);
+         });
+      });
    }
-   printf("%d %d\n", numV, numE);
+   for (auto& th : threads) th.join();
+   for (int i=0;i<n;i++) t.meta.merge(metas[i]);
+   CloseTextGraph(t);
 
+   uint32_t base = TextBase(t);
+   numV = TextNumV(t);
+   numE = t.meta.n_edges;
+   if (t.meta.start != ~0u) startNode = t.meta.start - base;
+   if (t.meta.end != ~0u) endNode = t.meta.end - base;
+
+   // merge the per-thread buffers, preserving file order per vertex
+   graph = new Vertex[numV];
+   if (app == APP_MAXFLOW) {
+      for (auto& part : parts) {
+         for (TextEdge& e : part) addEdge(e.src-base, e.dest-base, e.w);
+         std::vector<TextEdge>().swap(part);
+      }
+   } else {
+      std::vector<uint32_t> degree(numV, 0);
+      for (auto& part : parts) {
+         for (TextEdge& e : part) degree[e.src-base]++;
+      }
+      for (uint32_t i=0;i<numV;i++) graph[i].adj.reserve(degree[i]);
+      for (auto& part : parts) {
+         for (TextEdge& e : part) {
+            Adj a = {e.dest-base, e.w, 0};
+            graph[e.src-base].adj.push_back(a);
+         }
+         std::vector<TextEdge>().swap(part);
+      }
+   }
+   double ms = std::chrono::duration<double, std::milli>(
+         std::chrono::steady_clock::now() - start).count();
+   printf("Parsed %s: %d nodes, %d edges, %d thread(s), %f msec\n",
+         fmt_name[t.fmt], numV, numE, n, ms);
 }
+
 void LoadGraph(const char* file) {
    const uint32_t MAGIC_NUMBER = 0x150842A7 + 0; // increment every time you change the file format
    std::ifstream f;
@@ -244,7 +467,9 @@ void LoadGraph(const char* file) {
       uint32_t n = readU();
       graph[i].adj.resize(n);
       for (uint32_t j = 0; j < n; j++) graph[i].adj[j].n = readU();
-      for (uint32_t j = 0; j < n; j++) graph[i].adj[j].d_cm = readD()*EarthRadius_cm;
+      for (uint32_t j = 0; j < n; j++) {
+         graph[i].adj[j].d_cm = readD()*(app == APP_ASTAR ? EarthRadius_m : EarthRadius_cm);
+      }
       i++;
 
    }
@@ -396,60 +621,800 @@ void ConvertToCSR() {
 
 }
 
-struct compare_node {
-   bool operator() (const Node &a, const Node &b) const {
-      return a.bucket > b.bucket;
+// --reorder=<bfs,rcm,degree,gorder>: relabel vertices for locality.
+//
+// Each method produces an order (new ID -> old ID) that ApplyPermutation()
+// applies to the CSR arrays, graph[], startNode/endNode and csr_dist, so the
+// writers and ComputeReference() need no changes. Each vertex keeps its
+// adjacency order, which keeps the maxflow reverse-edge indices valid.
+const char* reorder_method = NULL;
+
+// Input ID of every vertex, composed over all ApplyPermutation() calls and
+// written to <out_file>.perm by WritePermutation(). Empty if never relabeled.
+std::vector<uint32_t> input_id;
+
+// Undirected view of the CSR graph (each arc in both directions).
+void BuildUndirected(std::vector<uint32_t>& off, std::vector<uint32_t>& ngh) {
+   off.assign(numV+1, 0);
+   for (uint32_t v=0;v<numV;v++) {
+      for (uint32_t e=csr_offset[v];e<csr_offset[v+1];e++) {
+         off[v+1]++;
+         off[csr_neighbors[e].n+1]++;
+      }
+   }
+   for (uint32_t v=0;v<numV;v++) off[v+1] += off[v];
+   ngh.resize(off[numV]);
+   std::vector<uint32_t> pos(off.begin(), off.end()-1);
+   for (uint32_t v=0;v<numV;v++) {
+      for (uint32_t e=csr_offset[v];e<csr_offset[v+1];e++) {
+         uint32_t u = csr_neighbors[e].n;
+         ngh[pos[v]++] = u;
+         ngh[pos[u]++] = v;
+      }
+   }
+}
+
+// Average |u - v| over all arcs, and the fraction of arcs whose endpoints
+// share a 64B line of the 4B-per-vertex dist array.
+double AvgNeighborGap(double* same_line) {
+   uint64_t sum = 0;
+   uint64_t same = 0;
+   for (uint32_t v=0;v<numV;v++) {
+      for (uint32_t e=csr_offset[v];e<csr_offset[v+1];e++) {
+         uint32_t u = csr_neighbors[e].n;
+         sum += (u > v) ? u - v : v - u;
+         same += (u >> 4) == (v >> 4);
+      }
+   }
+   *same_line = numE ? (double) same / numE : 0;
+   return numE ? (double) sum / numE : 0;
+}
+
+// BFS over out-edges from startNode, then from every unreached vertex.
+std::vector<uint32_t> OrderBFS() {
+   std::vector<uint32_t> order;
+   order.reserve(numV);
+   std::vector<bool> seen(numV, false);
+   auto bfs = [&](uint32_t root) {
+      if (seen[root]) return;
+      seen[root] = true;
+      size_t head = order.size();
+      order.push_back(root);
+      while (head < order.size()) {
+         uint32_t v = order[head++];
+         for (uint32_t e=csr_offset[v];e<csr_offset[v+1];e++) {
+            uint32_t u = csr_neighbors[e].n;
+            if (!seen[u]) {
+               seen[u] = true;
+               order.push_back(u);
+            }
+         }
+      }
+   };
+   if (startNode < numV) bfs(startNode);
+   for (uint32_t v=0;v<numV;v++) bfs(v);
+   return order;
+}
+
+// Reverse Cuthill-McKee on the undirected view. Each component starts from
+// its minimum-degree vertex; neighbors are visited in increasing degree.
+std::vector<uint32_t> OrderRCM() {
+   std::vector<uint32_t> off, ngh;
+   BuildUndirected(off, ngh);
+   auto deg = [&](uint32_t v) { return off[v+1] - off[v]; };
+   auto by_degree = [&](uint32_t a, uint32_t b) {
+      return deg(a) < deg(b) || (deg(a) == deg(b) && a < b);
+   };
+   std::vector<uint32_t> roots(numV);
+   std::iota(roots.begin(), roots.end(), 0);
+   std::sort(roots.begin(), roots.end(), by_degree);
+
+   std::vector<uint32_t> order;
+   order.reserve(numV);
+   std::vector<bool> seen(numV, false);
+   for (uint32_t root : roots) {
+      if (seen[root]) continue;
+      seen[root] = true;
+      size_t head = order.size();
+      order.push_back(root);
+      while (head < order.size()) {
+         uint32_t v = order[head++];
+         size_t first = order.size();
+         for (uint32_t e=off[v];e<off[v+1];e++) {
+            if (!seen[ngh[e]]) {
+               seen[ngh[e]] = true;
+               order.push_back(ngh[e]);
+            }
+         }
+         std::sort(order.begin() + first, order.end(), by_degree);
+      }
+   }
+   std::reverse(order.begin(), order.end());
+   return order;
+}
+
+// Decreasing out-degree (the order WriteOutputColor colors in).
+std::vector<uint32_t> OrderDegree() {
+   std::vector<NodeSort> vec(numV);
+   for (uint32_t i=0;i<numV;i++) {
+      NodeSort n = {i, csr_offset[i+1] - csr_offset[i]};
+      vec[i] = n;
+   }
+   std::sort(vec.begin(), vec.end(), degree_sort());
+   std::vector<uint32_t> order(numV);
+   for (uint32_t i=0;i<numV;i++) order[i] = vec[i].vid;
+   return order;
+}
+
+// Gorder (Wei et al., SIGMOD'16): greedily place the vertex with the most
+// neighbors and siblings (common neighbors) among the last 'window' placed
+// vertices. Scores live in a unit heap (per-score doubly linked lists), so
+// each score update is O(1). Sibling expansion skips hubs of degree
+// > sqrt(numV), as in the reference implementation.
+std::vector<uint32_t> OrderGorder(uint32_t window) {
+   const uint32_t NIL = ~0u;
+   std::vector<uint32_t> off, ngh;
+   BuildUndirected(off, ngh);
+   uint32_t hub = std::max<uint32_t>(16, sqrt(numV));
+
+   std::vector<uint32_t> key(numV, 0), prv(numV), nxt(numV), head(1, NIL);
+   std::vector<bool> placed(numV, false);
+   uint32_t top = 0;
+   auto unlink = [&](uint32_t v) {
+      if (prv[v] != NIL) nxt[prv[v]] = nxt[v]; else head[key[v]] = nxt[v];
+      if (nxt[v] != NIL) prv[nxt[v]] = prv[v];
+   };
+   auto link = [&](uint32_t v) {
+      uint32_t k = key[v];
+      if (k >= head.size()) head.resize(k+1, NIL);
+      prv[v] = NIL;
+      nxt[v] = head[k];
+      if (nxt[v] != NIL) prv[nxt[v]] = v;
+      head[k] = v;
+      if (k > top) top = k;
+   };
+   auto update = [&](uint32_t u, int delta) {
+      if (placed[u]) return;
+      unlink(u);
+      key[u] += delta;
+      link(u);
+   };
+   auto place = [&](uint32_t v, int delta) {
+      for (uint32_t e=off[v];e<off[v+1];e++) {
+         uint32_t w = ngh[e];
+         update(w, delta);
+         if (off[w+1] - off[w] > hub) continue;
+         for (uint32_t f=off[w];f<off[w+1];f++) {
+            if (ngh[f] != v) update(ngh[f], delta);
+         }
+      }
+   };
+   for (uint32_t v=numV;v-- > 0;) link(v);
+
+   uint32_t first = 0;
+   for (uint32_t v=0;v<numV;v++) {
+      if (off[v+1] - off[v] > off[first+1] - off[first]) first = v;
+   }
+   std::vector<uint32_t> order;
+   order.reserve(numV);
+   uint32_t v = first;
+   while (true) {
+      unlink(v);
+      placed[v] = true;
+      order.push_back(v);
+      if (order.size() == numV) break;
+      place(v, 1);
+      if (order.size() > window) place(order[order.size()-1-window], -1);
+      while (head[top] == NIL) top--;
+      v = head[top];
+   }
+   return order;
+}
+
+void ApplyPermutation(const std::vector<uint32_t>& order) {
+   std::vector<uint32_t> perm(numV);
+   for (uint32_t i=0;i<numV;i++) perm[order[i]] = i;
+   if (input_id.empty()) {
+      input_id.resize(numV);
+      std::iota(input_id.begin(), input_id.end(), 0);
+   }
+   std::vector<uint32_t> id(numV);
+   for (uint32_t i=0;i<numV;i++) id[i] = input_id[order[i]];
+   input_id.swap(id);
+
+   uint32_t* offset = (uint32_t*)(malloc (sizeof(uint32_t) * (numV+1)));
+   Adj* neighbors = (Adj*)(malloc (sizeof(Adj) * (numE)));
+   uint32_t* dist = (uint32_t*)(malloc (sizeof(uint32_t) * numV));
+   Vertex* g = new Vertex[numV];
+   uint32_t k = 0;
+   for (uint32_t i=0;i<numV;i++) {
+      uint32_t old = order[i];
+      offset[i] = k;
+      for (uint32_t e=csr_offset[old];e<csr_offset[old+1];e++) {
+         neighbors[k] = csr_neighbors[e];
+         neighbors[k++].n = perm[csr_neighbors[e].n];
+      }
+      dist[i] = csr_dist[old];
+      g[i].lat = graph[old].lat;
+      g[i].lon = graph[old].lon;
+      g[i].adj = std::move(graph[old].adj);
+      for (Adj& a : g[i].adj) a.n = perm[a.n];
+   }
+   offset[numV] = k;
+
+   free(csr_offset);
+   free(csr_neighbors);
+   free(csr_dist);
+   delete [] graph;
+   csr_offset = offset;
+   csr_neighbors = neighbors;
+   csr_dist = dist;
+   graph = g;
+   if (startNode < numV) startNode = perm[startNode];
+   if (endNode < numV) endNode = perm[endNode];
+}
+
+// numV little-endian uint32, entry i being the input ID of output vertex i.
+void WritePermutation(const char* out_file) {
+   std::string perm_file = std::string(out_file) + ".perm";
+   FILE* fp = fopen(perm_file.c_str(), "wb");
+   if (fp == NULL) {
+      printf("ERROR: Could not create %s\n", perm_file.c_str());
+      exit(1);
+   }
+   fwrite(input_id.data(), 4, input_id.size(), fp);
+   fclose(fp);
+   printf("Writing permutation %s\n", perm_file.c_str());
+}
+
+void Reorder(const char* method) {
+   double line_before, line_after;
+   double gap_before = AvgNeighborGap(&line_before);
+   clock_t t = clock();
+   std::vector<uint32_t> order;
+   if (strcmp(method, "bfs") == 0) {
+      order = OrderBFS();
+   } else if (strcmp(method, "rcm") == 0) {
+      order = OrderRCM();
+   } else if (strcmp(method, "degree") == 0) {
+      order = OrderDegree();
+   } else if (strcmp(method, "gorder") == 0) {
+      order = OrderGorder(5);
+   } else {
+      printf("Unknown --reorder method %s (bfs,rcm,degree,gorder)\n", method);
+      exit(0);
+   }
+   ApplyPermutation(order);
+   t = clock() - t;
+
+   double gap_after = AvgNeighborGap(&line_after);
+   printf("Reorder %s: avg neighbor ID gap %.1f -> %.1f, same-line arcs "
+         "%.1f%% -> %.1f%% (%f msec)\n", method, gap_before, gap_after,
+         line_before * 100, line_after * 100, ((float)t * 1000)/CLOCKS_PER_SEC);
+}
+
+// --partition=<n_tiles>: tile-aware relabeling.
+//
+// Tasks are sent to the tile that owns their object, i.e. their vertex ID,
+// under tsb_tile() (software/runtime/tsb_map.h, shared with bulk_enq.c).
+// test_chronos enables the hashed mapping for every app but astar, so that
+// is the default here too (hashed unless app is astar); an explicit
+// --tsb_hash=0|1 overrides it, 0 selecting the linear (object >> 4) %
+// n_tiles mapping. The graph is
+// split into n_tiles parts with a multilevel partitioner (heavy-edge
+// matching, greedy graph growing on the coarsest graph, boundary
+// refinement while uncoarsening). Part t is sized to the number of IDs in
+// [0, numV) that map to tile t, so the relabeling below fills exactly
+// those IDs and leaves no holes.
+uint32_t partition_tiles = 0;
+bool partition_tsb_hash = true;
+
+// Undirected graph with merged parallel edges, one level of the hierarchy.
+struct PGraph {
+   uint32_t n;
+   std::vector<uint32_t> off, adj, ew, vw;
+};
+
+void PGraphFromCSR(PGraph& g) {
+   std::vector<uint32_t> off, ngh;
+   BuildUndirected(off, ngh);
+   g.n = numV;
+   g.off.assign(numV+1, 0);
+   g.vw.assign(numV, 1);
+   g.adj.clear();
+   g.ew.clear();
+   for (uint32_t v=0;v<numV;v++) {
+      std::sort(ngh.begin() + off[v], ngh.begin() + off[v+1]);
+      for (uint32_t e=off[v];e<off[v+1];e++) {
+         uint32_t u = ngh[e];
+         if (u == v) continue;
+         if (g.adj.size() > g.off[v] && g.adj.back() == u) {
+            g.ew.back()++;
+         } else {
+            g.adj.push_back(u);
+            g.ew.push_back(1);
+         }
+      }
+      g.off[v+1] = g.adj.size();
+   }
+}
+
+// Heavy-edge matching; cmap maps each vertex of g to its vertex in c.
+void PGraphCoarsen(const PGraph& g, PGraph& c, std::vector<uint32_t>& cmap,
+      uint32_t max_vw, std::mt19937& rng) {
+   const uint32_t NIL = ~0u;
+   std::vector<uint32_t> order(g.n), match(g.n, NIL);
+   std::iota(order.begin(), order.end(), 0);
+   std::shuffle(order.begin(), order.end(), rng);
+   for (uint32_t v : order) {
+      if (match[v] != NIL) continue;
+      uint32_t best = v, best_w = 0;
+      for (uint32_t e=g.off[v];e<g.off[v+1];e++) {
+         uint32_t u = g.adj[e];
+         if (match[u] == NIL && g.ew[e] > best_w && g.vw[v] + g.vw[u] <= max_vw) {
+            best = u;
+            best_w = g.ew[e];
+         }
+      }
+      match[v] = best;
+      match[best] = v;
+   }
+   cmap.assign(g.n, NIL);
+   c.n = 0;
+   for (uint32_t v=0;v<g.n;v++) {
+      if (cmap[v] == NIL) cmap[v] = cmap[match[v]] = c.n++;
+   }
+   c.off.assign(c.n+1, 0);
+   c.vw.assign(c.n, 0);
+   c.adj.clear();
+   c.ew.clear();
+   std::vector<uint32_t> where(c.n, NIL);
+   uint32_t cv = 0;
+   for (uint32_t v=0;v<g.n;v++) {
+      if (cmap[v] != cv) continue;
+      size_t first = c.adj.size();
+      uint32_t pair[2] = {v, match[v]};
+      for (int k=0;k<(match[v] == v ? 1 : 2);k++) {
+         uint32_t x = pair[k];
+         c.vw[cv] += g.vw[x];
+         for (uint32_t e=g.off[x];e<g.off[x+1];e++) {
+            uint32_t cu = cmap[g.adj[e]];
+            if (cu == cv) continue;
+            if (where[cu] == NIL) {
+               where[cu] = c.adj.size();
+               c.adj.push_back(cu);
+               c.ew.push_back(0);
+            }
+            c.ew[where[cu]] += g.ew[e];
+         }
+      }
+      for (size_t e=first;e<c.adj.size();e++) where[c.adj[e]] = NIL;
+      c.off[++cv] = c.adj.size();
+   }
+}
+
+uint64_t PGraphCut(const PGraph& g, const std::vector<uint32_t>& part) {
+   uint64_t cut = 0;
+   for (uint32_t v=0;v<g.n;v++) {
+      for (uint32_t e=g.off[v];e<g.off[v+1];e++) {
+         if (part[v] != part[g.adj[e]]) cut += g.ew[e];
+      }
+   }
+   return cut / 2;
+}
+
+// Greedy graph growing: parts are grown one at a time from a random seed,
+// always adding the free vertex most connected to the part (lazy max-heap).
+void PGraphGrow(const PGraph& g, std::vector<uint32_t>& part,
+      const std::vector<uint64_t>& target, std::mt19937& rng) {
+   const uint32_t NIL = ~0u;
+   uint32_t k = target.size();
+   part.assign(g.n, NIL);
+   std::vector<uint32_t> conn(g.n, 0);
+   std::vector<uint32_t> seeds(g.n);
+   std::iota(seeds.begin(), seeds.end(), 0);
+   std::shuffle(seeds.begin(), seeds.end(), rng);
+   uint32_t next_seed = 0;
+   for (uint32_t p=0;p+1<k;p++) {
+      std::priority_queue<std::pair<uint32_t, uint32_t> > frontier;
+      std::vector<uint32_t> reached;
+      uint64_t w = 0;
+      while (w < target[p]) {
+         uint32_t best = NIL;
+         while (!frontier.empty() && best == NIL) {
+            std::pair<uint32_t, uint32_t> top = frontier.top();
+            frontier.pop();
+            if (part[top.second] == NIL && conn[top.second] == top.first) best = top.second;
+         }
+         if (best == NIL) {
+            while (next_seed < g.n && part[seeds[next_seed]] != NIL) next_seed++;
+            if (next_seed == g.n) break;
+            best = seeds[next_seed];
+         }
+         if (w + g.vw[best] > target[p] + target[p] / 32 && w > 0) break;
+         part[best] = p;
+         w += g.vw[best];
+         for (uint32_t e=g.off[best];e<g.off[best+1];e++) {
+            uint32_t u = g.adj[e];
+            if (part[u] != NIL) continue;
+            if (conn[u] == 0) reached.push_back(u);
+            conn[u] += g.ew[e];
+            frontier.push(std::make_pair(conn[u], u));
+         }
+      }
+      for (uint32_t u : reached) conn[u] = 0;
+   }
+   for (uint32_t v=0;v<g.n;v++) if (part[v] == NIL) part[v] = k-1;
+}
+
+// Greedy boundary refinement: move vertices to the adjacent part with the
+// largest cut reduction as long as it stays under max_w. Vertices of parts
+// above max_w may also make negative-gain moves.
+void PGraphRefine(const PGraph& g, std::vector<uint32_t>& part,
+      const std::vector<uint64_t>& max_w, std::mt19937& rng) {
+   uint32_t k = max_w.size();
+   std::vector<uint64_t> pw(k, 0);
+   for (uint32_t v=0;v<g.n;v++) pw[part[v]] += g.vw[v];
+   std::vector<int64_t> conn(k, 0);
+   std::vector<uint32_t> touched;
+   std::vector<uint32_t> order(g.n);
+   std::iota(order.begin(), order.end(), 0);
+   for (int pass=0;pass<8;pass++) {
+      std::shuffle(order.begin(), order.end(), rng);
+      uint32_t moved = 0;
+      for (uint32_t v : order) {
+         uint32_t from = part[v];
+         touched.clear();
+         for (uint32_t e=g.off[v];e<g.off[v+1];e++) {
+            uint32_t q = part[g.adj[e]];
+            if (conn[q] == 0) touched.push_back(q);
+            conn[q] += g.ew[e];
+         }
+         bool over = pw[from] > max_w[from];
+         uint32_t best = from;
+         int64_t best_gain = over ? INT64_MIN : 0;
+         for (uint32_t q : touched) {
+            if (q == from || pw[q] + g.vw[v] > max_w[q]) continue;
+            int64_t gain = conn[q] - conn[from];
+            if (gain > best_gain || (gain == best_gain && best != from &&
+                     pw[q] < pw[best])) {
+               best = q;
+               best_gain = gain;
+            }
+         }
+         for (uint32_t q : touched) conn[q] = 0;
+         conn[from] = 0;
+         if (best != from && (best_gain > 0 || over ||
+                  (best_gain == 0 && pw[best] + g.vw[v] < pw[from]))) {
+            part[v] = best;
+            pw[from] -= g.vw[v];
+            pw[best] += g.vw[v];
+            moved++;
+         }
+      }
+      if (moved == 0) break;
+   }
+}
+
+// Partitions g into parts with weights close to target.
+void PGraphPartition(const PGraph& g, std::vector<uint32_t>& part,
+      const std::vector<uint64_t>& target, std::mt19937& rng) {
+   uint32_t k = target.size();
+   std::vector<uint64_t> max_w(k);
+   for (uint32_t p=0;p<k;p++) max_w[p] = target[p] + target[p] / 32 + 1;
+
+   if (g.n <= std::max<uint32_t>(20 * k, 256)) {
+      std::vector<uint32_t> best;
+      uint64_t best_cut = ~0ull;
+      for (int trial=0;trial<8;trial++) {
+         PGraphGrow(g, part, target, rng);
+         PGraphRefine(g, part, max_w, rng);
+         uint64_t cut = PGraphCut(g, part);
+         if (cut < best_cut) {
+            best_cut = cut;
+            best = part;
+         }
+      }
+      part.swap(best);
+      return;
+   }
+   uint64_t total = std::accumulate(g.vw.begin(), g.vw.end(), 0ull);
+   PGraph c;
+   std::vector<uint32_t> cmap;
+   PGraphCoarsen(g, c, cmap, std::max<uint64_t>(1, total / (20 * k)), rng);
+   if (c.n > g.n - g.n / 16) {
+      // matching stalled (e.g. stars): partition this level directly
+      PGraphGrow(g, part, target, rng);
+      PGraphRefine(g, part, max_w, rng);
+      return;
+   }
+   std::vector<uint32_t> cpart;
+   PGraphPartition(c, cpart, target, rng);
+   part.resize(g.n);
+   for (uint32_t v=0;v<g.n;v++) part[v] = cpart[cmap[v]];
+   PGraphRefine(g, part, max_w, rng);
+}
+
+// Moves the cheapest vertices from parts above their target to parts below
+// it until every part has exactly its target size (unit vertex weights).
+void PGraphBalanceExact(const PGraph& g, std::vector<uint32_t>& part,
+      const std::vector<uint64_t>& target) {
+   uint32_t k = target.size();
+   std::vector<int64_t> excess(k, 0);
+   for (uint32_t v=0;v<g.n;v++) excess[part[v]]++;
+   for (uint32_t p=0;p<k;p++) excess[p] -= target[p];
+   std::vector<int64_t> conn(k, 0);
+   while (true) {
+      struct Move { int64_t gain; uint32_t v, to; };
+      std::vector<Move> moves;
+      for (uint32_t v=0;v<g.n;v++) {
+         uint32_t from = part[v];
+         if (excess[from] <= 0) continue;
+         for (uint32_t e=g.off[v];e<g.off[v+1];e++) conn[part[g.adj[e]]] += g.ew[e];
+         Move m = {INT64_MIN, v, from};
+         for (uint32_t q=0;q<k;q++) {
+            if (excess[q] < 0 && conn[q] - conn[from] > m.gain) {
+               m.gain = conn[q] - conn[from];
+               m.to = q;
+            }
+         }
+         for (uint32_t e=g.off[v];e<g.off[v+1];e++) conn[part[g.adj[e]]] = 0;
+         if (m.to != from) moves.push_back(m);
+      }
+      if (moves.empty()) break;
+      std::sort(moves.begin(), moves.end(),
+            [](const Move& a, const Move& b) { return a.gain > b.gain; });
+      for (Move& m : moves) {
+         uint32_t from = part[m.v];
+         if (excess[from] <= 0 || excess[m.to] >= 0) continue;
+         part[m.v] = m.to;
+         excess[from]--;
+         excess[m.to]++;
+      }
+   }
+}
+
+// Fraction of arcs whose endpoints live on different tiles (each relaxed arc
+// is a child task sent from the tile of its source to the tile of its
+// destination), and max/avg of the expected tasks per tile (in-degree).
+void TileStats(uint32_t n_tiles, double* cross, double* imbalance) {
+   std::vector<uint32_t> tile(numV);
+   for (uint32_t v=0;v<numV;v++) tile[v] = tsb_tile(v, n_tiles, partition_tsb_hash);
+   std::vector<uint64_t> load(n_tiles, 0);
+   uint64_t n_cross = 0;
+   for (uint32_t v=0;v<numV;v++) {
+      for (uint32_t e=csr_offset[v];e<csr_offset[v+1];e++) {
+         uint32_t u = csr_neighbors[e].n;
+         n_cross += tile[v] != tile[u];
+         load[tile[u]]++;
+      }
+   }
+   uint64_t max_load = *std::max_element(load.begin(), load.end());
+   *cross = numE ? (double) n_cross / numE : 0;
+   *imbalance = numE ? (double) max_load * n_tiles / numE : 1;
+}
+
+void PartitionTiles(uint32_t n_tiles) {
+   double cross_before, imb_before, cross_after, imb_after;
+   TileStats(n_tiles, &cross_before, &imb_before);
+   clock_t t = clock();
+
+   // IDs available on each tile
+   std::vector<std::vector<uint32_t> > slots(n_tiles);
+   for (uint32_t v=0;v<numV;v++) {
+      slots[tsb_tile(v, n_tiles, partition_tsb_hash)].push_back(v);
+   }
+   std::vector<uint64_t> target(n_tiles);
+   for (uint32_t p=0;p<n_tiles;p++) target[p] = slots[p].size();
+
+   PGraph g;
+   PGraphFromCSR(g);
+   std::vector<uint32_t> part;
+   std::mt19937 rng(0);
+   PGraphPartition(g, part, target, rng);
+   PGraphBalanceExact(g, part, target);
+
+   // part p takes tile p's IDs in increasing order, keeping relative order
+   std::vector<uint32_t> order(numV);
+   std::vector<uint32_t> next(n_tiles, 0);
+   for (uint32_t v=0;v<numV;v++) {
+      uint32_t p = part[v];
+      order[slots[p][next[p]++]] = v;
    }
+   ApplyPermutation(order);
+   t = clock() - t;
+
+   TileStats(n_tiles, &cross_after, &imb_after);
+   printf("Partition %d tiles (%s mapping): edge cut %lu, "
+         "cross-tile tasks %.1f%% -> %.1f%%, load imbalance %.2f -> %.2f "
+         "(%f msec)\n", n_tiles, partition_tsb_hash ? "hashed" : "linear",
+         PGraphCut(g, part), cross_before * 100, cross_after * 100,
+         imb_before, imb_after, ((float)t * 1000)/CLOCKS_PER_SEC);
+}
+
+// Monotone radix heap (Ahuja et al.) for integer keys: a key is kept in
+// the bucket of the highest bit in which it differs from the last popped
+// key, so each entry is moved at most 32 times. Valid because Dijkstra and
+// the A* below (ts = max(parent ts, ...)) never push a key below the last
+// popped one.
+template <typename T>
+class RadixHeap {
+  public:
+   void push(uint32_t key, const T& v) {
+      buckets[bucket(key)].push_back(std::make_pair(key, v));
+      n++;
+   }
+   bool empty() const { return n == 0; }
+   size_t size() const { return n; }
+   std::pair<uint32_t, T> pop() {
+      if (buckets[0].empty()) {
+         int i = 1;
+         while (buckets[i].empty()) i++;
+         last = buckets[i][0].first;
+         for (auto& e : buckets[i]) last = std::min(last, e.first);
+         for (auto& e : buckets[i]) buckets[bucket(e.first)].push_back(e);
+         buckets[i].clear();
+      }
+      std::pair<uint32_t, T> e = buckets[0].back();
+      buckets[0].pop_back();
+      n--;
+      return e;
+   }
+  private:
+   int bucket(uint32_t key) const {
+      return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+   }
+   std::vector<std::pair<uint32_t, T> > buckets[33];
+   uint32_t last = 0;
+   size_t n = 0;
+};
+
+struct SearchStats {
+   uint64_t relaxed = 0;     // arcs scanned
+   uint64_t pushes = 0;
+   size_t max_heap = 0;
 };
+
+void PrintSearchStats(const SearchStats& s, clock_t t) {
+   printf("Time taken :%f msec\n", ((float)t * 1000)/CLOCKS_PER_SEC);
+   printf("Max PQ size %lu\n", s.max_heap);
+   printf("edges relaxed %lu, pushes %lu\n", s.relaxed, s.pushes);
+}
+
+// Dijkstra from src into dist[] (all ~0 on entry). Arcs of v are
+// [offset[v], offset[v+1]); arc(e, &neighbor, &weight) decodes one.
+template <typename F>
+SearchStats Dijkstra(uint32_t src, const uint32_t* offset, uint32_t* dist, F arc) {
+   SearchStats s;
+   RadixHeap<uint32_t> heap;
+   dist[src] = 0;
+   heap.push(0, src);
+   while (!heap.empty()) {
+      s.max_heap = std::max(s.max_heap, heap.size());
+      std::pair<uint32_t, uint32_t> top = heap.pop();
+      uint32_t d = top.first;
+      uint32_t v = top.second;
+      if (d > dist[v]) continue;
+      for (uint32_t e=offset[v];e<offset[v+1];e++) {
+         uint32_t u, w;
+         arc(e, &u, &w);
+         s.relaxed++;
+         if (d + w < dist[u]) {
+            dist[u] = d + w;
+            heap.push(d + w, u);
+            s.pushes++;
+         }
+      }
+   }
+   return s;
+}
+
 void ComputeReference(){
-   uint32_t  delta = 1;
    printf("Compute Reference\n");
-   std::priority_queue<Node, std::vector<Node>, compare_node> pq;
+   clock_t t = clock();
+   SearchStats s = Dijkstra(startNode, csr_offset, csr_dist,
+         [](uint32_t e, uint32_t* u, uint32_t* w) {
+      *u = csr_neighbors[e].n;
+      *w = csr_neighbors[e].d_cm;
+   });
+   t = clock() -t;
+   printf("Node %d dist:%d\n", numV -1, csr_dist[numV-1]);
+   PrintSearchStats(s, t);
+}
 
-    // cache flush
-#if 0
-    const int size = 20*1024*1024;
-    char *c = (char *) malloc(size);
-    for (int i=0;i<0xff;i++) {
-       // printf("%d\n", i);
+// A* reference for the astar app, matching hls/astar/astar_test.cpp: tasks
+// are ordered by ts = max(parent ts, g + h), a vertex's ground truth is the
+// ts it is first dequeued with (~0 if never), and the search stops when
+// endNode is dequeued. Lat/lon are ap_fixed<32,3> (29 fraction bits), as
+// written to the image.
+int32_t LatLonFixed(double rad) {
+   return (int32_t) floor(rad * (1 << 29));
+}
 
-        for (int j=0;j<size;j++)
-            c[j] = i*j;
-    }
-#endif
-   uint32_t max_pq_size = 0;
-   int edges_traversed = 0;
+// hls/astar/fxp_sqrt.h fxp_sqrt() for ap_ufixed<32,8> in and out
+// (QW = 29, SCALE = -4), with the ap_int<31>/ap_uint<29> wraparound.
+uint32_t FxpSqrt(uint32_t in) {
+   const int ROOT_PREC = 29;
+   auto s31 = [](int64_t x) { return (int64_t) ((uint64_t) x << 33) >> 33; };
+   const uint64_t Q_MASK = (1u << 29) - 1;
+   uint64_t q = 0, q_star = 0;
+   int64_t s = s31(((in >> 3) + 1) >> 1);
+   for (int i = 0; i <= ROOT_PREC; i++) {
+      if (s >= 0) {
+         s = s31(2 * s - s31(s31(s31(q << 2) | 1) << (ROOT_PREC - i)));
+         q_star = (q << 1) & Q_MASK;
+         q = ((q << 1) | 1) & Q_MASK;
+      } else {
+         s = s31(2 * s + s31(s31(s31(q_star << 2) | 3) << (ROOT_PREC - i)));
+         q = ((q_star << 1) | 1) & Q_MASK;
+         q_star = (q_star << 1) & Q_MASK;
+      }
+   }
+   if (s > 0) q = (q + 1) & Q_MASK;
+   return q >> 1;
+}
+
+// hls/astar/astar.cpp astar_dist() in integer arithmetic: 2*sqrt(a)*R in
+// metres. hls::sin/cos are replaced by libm truncated to ap_fixed<32,3>,
+// which can differ in the last bit (well inside the runtime's 5m tolerance).
+uint32_t AstarDist(int32_t src_lat, int32_t src_lon, int32_t dst_lat, int32_t dst_lon) {
+   auto fx = [](double x) { return (int64_t) floor(x * (1 << 29)); };
+   auto rad = [](int32_t x) { return x / (double) (1 << 29); };
+   int64_t latS = fx(sin(rad((int32_t) ((uint32_t) src_lat - dst_lat))));
+   int64_t lonS = fx(sin(rad((int32_t) ((uint32_t) src_lon - dst_lon))));
+   int64_t latSrcC = fx(cos(rad(src_lat)));
+   int64_t latDstC = fx(cos(rad(dst_lat)));
+   // a = latS^2 + lonS^2*cos*cos, exact at 2^-116, then ap_ufixed<64,8>
+   __int128 a116 = ((__int128) (latS * latS) << 58) +
+      (__int128) (lonS * lonS) * (latSrcC * latDstC);
+   uint64_t a = (uint64_t) (a116 >> 60);
+   a <<= 16;
+   uint32_t ua = a >> 32;                         // ap_ufixed<32,8>
+   uint32_t sqrta = FxpSqrt(ua) >> 8;             // 24 fraction bits
+   return ((uint64_t) sqrta * 2 * 6371000) >> 24;
+}
 
+struct AstarTask {
+   uint32_t vid;
+   uint32_t g;
+};
+
+void ComputeReferenceAstar() {
+   printf("Compute Reference (A* %d -> %d)\n", startNode, endNode);
+   std::vector<int32_t> lat(numV), lon(numV);
+   for (uint32_t i=0;i<numV;i++) {
+      lat[i] = LatLonFixed(graph[i].lat);
+      lon[i] = LatLonFixed(graph[i].lon);
+   }
+   auto h = [&](uint32_t v) {
+      return AstarDist(lat[v], lon[v], lat[endNode], lon[endNode]);
+   };
    clock_t t = clock();
-   Node v = {startNode, 0, 0};
-   pq.push(v);
-   while(!pq.empty()){
-      Node n = pq.top();
-      uint32_t vid = n.vid;
-      uint32_t dist = n.dist;
-      //printf("visit %d %d\n", vid, dist);
-      pq.pop();
-      max_pq_size = pq.size() < max_pq_size ?  max_pq_size : pq.size();
-      edges_traversed++;
-      if (csr_dist[vid] > dist) {
-         csr_dist[vid] = dist;
-
-         uint32_t ngh = csr_offset[vid];
-         uint32_t nghEnd = csr_offset[vid+1];
-
-         while(ngh != nghEnd) {
-            Adj a = csr_neighbors[ngh++];
-            Node e = {a.n, dist +  a.d_cm, (dist+a.d_cm)/delta};
-            //printf(" -> %d %d\n", a.n, dist+ a.d_cm);
-            pq.push(e);
+   SearchStats s;
+   RadixHeap<AstarTask> heap;
+   AstarTask init = {startNode, 0};
+   heap.push(h(startNode), init);
+   while (!heap.empty()) {
+      s.max_heap = std::max(s.max_heap, heap.size());
+      std::pair<uint32_t, AstarTask> top = heap.pop();
+      uint32_t ts = top.first;
+      AstarTask task = top.second;
+      if (ts >= csr_dist[task.vid]) continue;
+      csr_dist[task.vid] = ts;
+      if (task.vid == endNode) break;
+      for (uint32_t e=csr_offset[task.vid];e<csr_offset[task.vid+1];e++) {
+         s.relaxed++;
+         AstarTask n = {csr_neighbors[e].n, task.g + csr_neighbors[e].d_cm};
+         uint32_t n_ts = std::max(ts, n.g + h(n.vid));
+         if (n_ts < csr_dist[n.vid]) {
+            heap.push(n_ts, n);
+            s.pushes++;
          }
       }
    }
    t = clock() -t;
-   printf("Time taken :%f msec\n", ((float)t * 1000)/CLOCKS_PER_SEC);
-   printf("Node %d dist:%d\n", numV -1, csr_dist[numV-1]);
-   printf("Max PQ size %d\n", max_pq_size);
-   printf("edges traversed %d\n", edges_traversed);
+   printf("Node %d dist:%d\n", endNode, csr_dist[endNode]);
+   PrintSearchStats(s, t);
 }
 
 int size_of_field(int items, int size_of_item){
@@ -712,6 +1677,227 @@ void WriteOutputMaxflow(FILE* fp) {
 
 }
 
+// Out-of-core SSSP conversion of text inputs (see LoadGraphText).
+//
+// The in-memory path holds the graph three times (Vertex::adj, the CSR
+// arrays and the calloc'd image). Here the input is read twice instead:
+// pass 1 counts out-degrees, pass 2 scatters each arc straight into the
+// mmap'd output file, which is laid out exactly as WriteOutput() would
+// write it. The only large allocations are the per-vertex degree and cursor
+// arrays.
+// When the neighbor array exceeds stream_mem_bytes, pass 2 is repeated once
+// per window of source vertices and each window is flushed and dropped from
+// the page cache before the next, so inputs that are not sorted by source
+// do not leave the whole image dirty.
+
+// Write back words [begin, end) of the image and drop them from the page cache.
+void FlushImage(uint32_t* data, uint64_t begin, uint64_t end) {
+   const uint64_t page = sysconf(_SC_PAGESIZE);
+   uint64_t b = (begin * 4) & ~(page-1);
+   uint64_t e = ((end * 4) + page-1) & ~(page-1);
+   char* p = (char*) data;
+   msync(p + b, e - b, MS_SYNC);
+   madvise(p + b, e - b, MADV_DONTNEED);
+}
+
+// Dijkstra over an SSSP image (WriteOutput layout), writing the distances
+// into its ground truth region.
+void ComputeReferenceImage(uint32_t* data) {
+   uint32_t n_vertices = data[1];
+   uint32_t* offset = data + data[3];
+   uint32_t* neighbors = data + data[4];
+   uint32_t* gt = data + data[6];
+   printf("Compute Reference\n");
+   clock_t t = clock();
+   SearchStats s = Dijkstra(data[7], offset, gt,
+         [&](uint32_t e, uint32_t* u, uint32_t* w) {
+      *u = neighbors[2*e];
+      *w = neighbors[2*e+1];
+   });
+   t = clock() -t;
+   printf("Node %d dist:%d\n", n_vertices -1, gt[n_vertices-1]);
+   PrintSearchStats(s, t);
+}
+
+void BuildStreamGR(const char* file, const char* out_file) {
+   TextGraph text;
+   OpenTextGraph(file, text);
+
+   // pass 1: degrees, indexed by the ID as written until the base is known
+   clock_t t = clock();
+   std::vector<uint32_t> degree;
+   ScanTextGraph(text, [&](uint32_t src, uint32_t, uint32_t) {
+      if (src >= degree.size()) degree.resize(std::max<size_t>(src+1, degree.size()*2));
+      degree[src]++;
+   });
+   if (text.meta.n_edges == 0) {
+      printf("ERROR: no arcs in %s\n", file);
+      exit(1);
+   }
+   if (text.meta.n_edges > 0xFFFFFFFFull) {
+      printf("ERROR: more than 2^32 arcs\n");
+      exit(1);
+   }
+   uint32_t base = TextBase(text);
+   numV = TextNumV(text);
+   numE = text.meta.n_edges;
+   if (text.meta.start != ~0u) startNode = text.meta.start - base;
+   if (text.meta.end != ~0u) endNode = text.meta.end - base;
+
+   uint32_t* cursor = (uint32_t*) calloc(numV+1, sizeof(uint32_t));
+   uint32_t n_edges = 0;
+   for (uint32_t i=0;i<numV;i++) {
+      cursor[i] = n_edges;
+      if (i + base < degree.size()) n_edges += degree[i + base];
+   }
+   cursor[numV] = n_edges;
+   std::vector<uint32_t>().swap(degree);
+   printf("Read %d nodes, %d adjacencies (%f msec)\n", numV, numE,
+         ((float)(clock()-t) * 1000)/CLOCKS_PER_SEC);
+
+   // same layout as WriteOutput(), in 64-bit arithmetic
+   uint64_t SIZE_DIST =((numV+15ull)/16)*16;
+   uint64_t SIZE_EDGE_OFFSET =( (numV+1ull +15)/ 16) * 16;
+   uint64_t SIZE_NEIGHBORS =(( (numE* 8ull)+ 63)/64 ) * 16;
+   uint64_t SIZE_GROUND_TRUTH =((numV+15ull)/16)*16;
+
+   uint64_t BASE_DIST = 16;
+   uint64_t BASE_EDGE_OFFSET = BASE_DIST + SIZE_DIST;
+   uint64_t BASE_NEIGHBORS = BASE_EDGE_OFFSET + SIZE_EDGE_OFFSET;
+   uint64_t BASE_GROUND_TRUTH = BASE_NEIGHBORS + SIZE_NEIGHBORS;
+
+   uint64_t BASE_END = BASE_GROUND_TRUTH + SIZE_GROUND_TRUTH;
+   if (BASE_END > 0xFFFFFFFFull) {
+      printf("ERROR: image of %lu words does not fit 32-bit headers\n", BASE_END);
+      exit(1);
+   }
+
+   int fd = open(out_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0 || ftruncate(fd, BASE_END * 4) != 0) {
+      printf("ERROR: Could not create %s\n", out_file);
+      exit(1);
+   }
+   uint32_t* data = (uint32_t*) mmap(NULL, BASE_END * 4,
+         PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (data == MAP_FAILED) {
+      printf("ERROR: Could not map %s\n", out_file);
+      exit(1);
+   }
+   printf("Writing file %s (%lu MB, streaming)\n", out_file, (BASE_END * 4) >> 20);
+
+   data[0] = MAGIC_OP;
+   data[1] = numV;
+   data[2] = numE;
+   data[3] = BASE_EDGE_OFFSET;
+   data[4] = BASE_NEIGHBORS;
+   data[5] = BASE_DIST;
+   data[6] = BASE_GROUND_TRUTH;
+   data[7] = startNode;
+   data[8] = BASE_END;
+
+   for (int i=0;i<9;i++) {
+      printf("header %d: %d\n", i, data[i]);
+   }
+
+   for (uint32_t i=0;i<numV;i++) {
+      data[BASE_EDGE_OFFSET +i] = cursor[i];
+      data[BASE_DIST+i] = 0xFFFFFFFF;
+      data[BASE_GROUND_TRUTH +i] = 0xFFFFFFFF;
+   }
+   data[BASE_EDGE_OFFSET +numV] = cursor[numV];
+   FlushImage(data, 0, BASE_NEIGHBORS);
+
+   // pass 2: scatter, one window of source vertices at a time
+   uint64_t window_edges = stream_mem_bytes / 8;
+   uint32_t lo = 0;
+   int n_windows = 0;
+   t = clock();
+   while (lo < numV) {
+      uint32_t hi = lo + 1;
+      while (hi < numV && data[BASE_EDGE_OFFSET+hi+1] -
+            data[BASE_EDGE_OFFSET+lo] <= window_edges) hi++;
+      ScanTextGraph(text, [&](uint32_t src, uint32_t dest, uint32_t w) {
+         src -= base;
+         dest -= base;
+         if (src < lo || src >= hi) return;
+         uint64_t e = cursor[src]++;
+         data[BASE_NEIGHBORS + 2*e] = dest;
+         data[BASE_NEIGHBORS + 2*e+1] = w;
+      });
+      FlushImage(data, BASE_NEIGHBORS + 2ull*data[BASE_EDGE_OFFSET+lo],
+            BASE_NEIGHBORS + 2ull*data[BASE_EDGE_OFFSET+hi]);
+      lo = hi;
+      n_windows++;
+   }
+   printf("Scattered %d adjacencies in %d pass(es) (%f msec)\n", numE,
+         n_windows, ((float)(clock()-t) * 1000)/CLOCKS_PER_SEC);
+   free(cursor);
+   CloseTextGraph(text);
+
+   ComputeReferenceImage(data);
+
+   munmap(data, BASE_END * 4);
+   close(fd);
+}
+
+// Same layout as hls/astar/astar_test.cpp WriteFile(), in binary.
+void WriteOutputAstar(FILE* fp) {
+   // all offsets are in units of uint32_t. i.e 16 per cache line
+   int SIZE_DATA = size_of_field(numV, 4);
+   int SIZE_EDGE_OFFSET = size_of_field(numV+1, 4);
+   int SIZE_NEIGHBORS = size_of_field(numE, 8);
+   int SIZE_LATLON = size_of_field(numV, 8);
+   int SIZE_GROUND_TRUTH = size_of_field(numV, 4);
+
+   int BASE_DATA = 16;
+   int BASE_EDGE_OFFSET = BASE_DATA + SIZE_DATA;
+   int BASE_NEIGHBORS = BASE_EDGE_OFFSET + SIZE_EDGE_OFFSET;
+   int BASE_LATLON = BASE_NEIGHBORS + SIZE_NEIGHBORS;
+   int BASE_GROUND_TRUTH = BASE_LATLON + SIZE_LATLON;
+   int BASE_END = BASE_GROUND_TRUTH + SIZE_GROUND_TRUTH;
+
+   uint32_t* data = (uint32_t*) calloc(BASE_END, sizeof(uint32_t));
+
+   data[0] = MAGIC_OP;
+   data[1] = numV;
+   data[2] = numE;
+   data[3] = BASE_EDGE_OFFSET;
+   data[4] = BASE_NEIGHBORS;
+   data[5] = BASE_DATA;
+   data[6] = BASE_LATLON;
+   data[7] = startNode;
+   data[8] = endNode;
+   data[9] = BASE_GROUND_TRUTH;
+   data[10] = BASE_END;
+   data[11] = LatLonFixed(graph[endNode].lat);
+   data[12] = LatLonFixed(graph[endNode].lon);
+
+   for (int i=0;i<13;i++) {
+      printf("header %d: %d\n", i, data[i]);
+   }
+
+   for (uint32_t i=0;i<numV;i++) {
+      data[BASE_EDGE_OFFSET +i] = csr_offset[i];
+      data[BASE_DATA+i] = 0xFFFFFFFF;
+      data[BASE_LATLON + i*2] = LatLonFixed(graph[i].lat);
+      data[BASE_LATLON + i*2+1] = LatLonFixed(graph[i].lon);
+      data[BASE_GROUND_TRUTH +i] = csr_dist[i];
+   }
+   data[BASE_EDGE_OFFSET +numV] = csr_offset[numV];
+
+   for (uint32_t i=0;i<numE;i++) {
+      data[ BASE_NEIGHBORS +2*i ] = csr_neighbors[i].n;
+      data[ BASE_NEIGHBORS +2*i+1] = csr_neighbors[i].d_cm;
+   }
+
+   printf("Writing file \n");
+   fwrite(data, 4, BASE_END, fp);
+   fclose(fp);
+
+   free(data);
+
+}
+
 void WriteDimacs(FILE* fp) {
    // all offsets are in units of uint32_t. i.e 16 per cache line
 
@@ -744,8 +1930,34 @@ int main(int argc, char *argv[]) {
    char dimacs_file[50];
    char edgesFile[50];
    char ext[50];
+   // strip options so that the positional arguments keep their meaning
+   int n_args = 1;
+   int tsb_hash_opt = -1;  // -1: follow the app, as test_chronos does
+   for (int i=1;i<argc;i++) {
+      if (strncmp(argv[i], "--stream", 8) == 0) {
+         stream_mem_bytes = (argv[i][8] == '=') ?
+            strtoull(argv[i]+9, NULL, 10) << 20 : (1ull << 30);
+         if (stream_mem_bytes == 0) stream_mem_bytes = 1 << 20;
+      } else if (strncmp(argv[i], "--reorder=", 10) == 0) {
+         reorder_method = argv[i]+10;
+      } else if (strncmp(argv[i], "--partition=", 12) == 0) {
+         partition_tiles = atoi(argv[i]+12);
+      } else if (strncmp(argv[i], "--tsb_hash=", 11) == 0) {
+         tsb_hash_opt = atoi(argv[i]+11);
+      } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+         n_threads = atoi(argv[i]+10);
+      } else if (strncmp(argv[i], "--", 2) == 0) {
+         printf("Unknown option %s\n", argv[i]);
+         exit(0);
+      } else {
+         argv[n_args++] = argv[i];
+      }
+   }
+   argc = n_args;
    if (argc < 3) {
-      printf("Usage: graph_gen app type=<latlon,grid,gr,color> type_args\n");
+      printf("Usage: graph_gen app=<sssp,color,flow,astar> type=<latlon,grid,gr,color> type_args [--stream[=MB]] [--threads=N]\n"
+             "       [--reorder=bfs|rcm|degree|gorder] [--partition=n_tiles [--tsb_hash=0|1]]\n"
+             "       (--tsb_hash defaults to 1, or 0 for astar, matching test_chronos)\n");
       exit(0);
    }
    if (strcmp(argv[1], "sssp") ==0) {
@@ -760,11 +1972,28 @@ int main(int argc, char *argv[]) {
       app = APP_MAXFLOW;
       sprintf(ext, "%s", "flow");
    }
+   if (strcmp(argv[1], "astar") ==0) {
+      app = APP_ASTAR;
+      sprintf(ext, "%s", "astar");
+      if (strcmp(argv[2], "latlon") != 0) {
+         printf("astar needs a latlon input\n");
+         exit(0);
+      }
+   }
+   partition_tsb_hash = (tsb_hash_opt < 0) ? (app != APP_ASTAR) : (tsb_hash_opt != 0);
 
    startNode = 0;
    if (strcmp(argv[2], "latlon") ==0) {
-      // astar type
+      // astar type: graph_gen <app> latlon <file> [src dst]
       LoadGraph(argv[3]);
+      if (app == APP_ASTAR) {
+         startNode = (argc > 5) ? atoi(argv[4]) : numV / 10;
+         endNode = (argc > 5) ? atoi(argv[5]) : 9 * (numV / 10);
+         if (startNode >= numV || endNode >= numV) {
+            printf("astar src/dst out of range\n");
+            exit(0);
+         }
+      }
       int strStart = 0;
       // strip out filename from path
       for (uint32_t i=0;i<strlen(argv[3]);i++) {
@@ -786,7 +2015,6 @@ int main(int argc, char *argv[]) {
       sprintf(out_file, "grid_%dx%d.%s", r,c, ext);
       sprintf(dimacs_file, "grid_%dx%d.dimacs", r,c);
    } else if (strcmp(argv[2], "gr") == 0) {
-      LoadGraphGR(argv[3]);
       int strStart = 0;
       // strip out filename from path
       for (uint32_t i=0;i<strlen(argv[3]);i++) {
@@ -794,9 +2022,18 @@ int main(int argc, char *argv[]) {
       }
       sprintf(out_file, "%s.%s", argv[3] +strStart, ext);
       sprintf(edgesFile, "%s.edges", argv[3] +strStart);
+      if (stream_mem_bytes) {
+         if (app != APP_SSSP || reorder_method || partition_tiles) {
+            printf("--stream only supports sssp without --reorder/--partition\n");
+            exit(0);
+         }
+         BuildStreamGR(argv[3], out_file);
+         return 0;
+      }
+      LoadGraphText(argv[3]);
    } else if (strcmp(argv[2], "color") == 0) {
-      // coloring type : eg: com-youtube
-      LoadGraphEdges(argv[3]);
+      // coloring type : eg: com-youtube (any format LoadGraphText reads)
+      LoadGraphText(argv[3]);
       int strStart = 0;
       // strip out filename from path
       for (uint32_t i=0;i<strlen(argv[3]);i++) {
@@ -810,8 +2047,20 @@ int main(int argc, char *argv[]) {
 
    ConvertToCSR();
 
+   if (reorder_method) {
+      Reorder(reorder_method);
+   }
+   if (partition_tiles) {
+      PartitionTiles(partition_tiles);
+   }
+   if (!input_id.empty()) {
+      WritePermutation(out_file);
+   }
+
    if (app == APP_SSSP) {
       ComputeReference();
+   } else if (app == APP_ASTAR) {
+      ComputeReferenceAstar();
    }
 
    FILE* fp;
@@ -828,6 +2077,8 @@ int main(int argc, char *argv[]) {
       WriteOutputColor(fp);
    } else if (app == APP_MAXFLOW) {
       WriteOutputMaxflow(fp);
+   } else if (app == APP_ASTAR) {
+      WriteOutputAstar(fp);
    }
    return 0;
 }